@@ -0,0 +1,390 @@
+// fsr31mock: ffx-api provider without a GPU behind it. Contexts are plain allocations,
+// upscale queries get the same answers the real runtime gives and everything else succeeds.
+#include "fsr31mock.h"
+#include "ffx_upscale.h"
+#include "ffx_framegeneration.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+constexpr uint64_t MockVersionId = 0x00030001;
+constexpr const char* MockVersionName = "3.1.0 (fsr31mock)";
+constexpr uint32_t MockContextMagic = 0x4d4f434b;
+
+struct MockContext
+{
+    uint32_t magic;
+    uint32_t effect;
+    FfxApiDimensions2D maxRenderSize;
+    FfxApiDimensions2D maxUpscaleSize;
+    ffxAllocationCallbacks allocator;
+    FfxApiPresentCallbackFunc presentCallback;
+    void* presentCallbackUserContext;
+};
+
+static std::atomic<uint64_t> _latency[FSR31MOCK_ENTRY_COUNT];
+static std::atomic<ffxReturnCode_t> _result[FSR31MOCK_ENTRY_COUNT];
+static std::atomic<uint64_t> _calls[FSR31MOCK_ENTRY_COUNT];
+static std::atomic<uint64_t> _liveContexts{ 0 };
+
+static struct MockDefaults
+{
+    MockDefaults() { fsr31mockReset(); }
+} _defaults;
+
+// Spins rather than sleeps, sleeping can't hit microsecond latencies
+static void simulateLatency(uint32_t entry)
+{
+    auto nanoseconds = _latency[entry].load(std::memory_order_relaxed);
+
+    if (nanoseconds == 0)
+        return;
+
+    auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(nanoseconds);
+    while (std::chrono::steady_clock::now() < end)
+    {
+    }
+}
+
+// Counts the call and waits out its latency, true with result set when a result is injected
+static bool beginCall(uint32_t entry, ffxReturnCode_t& result)
+{
+    _calls[entry].fetch_add(1, std::memory_order_relaxed);
+    simulateLatency(entry);
+
+    result = _result[entry].load(std::memory_order_relaxed);
+    return result != FSR31MOCK_RESULT_DEFAULT;
+}
+
+static MockContext* mockContext(ffxContext* context)
+{
+    if (context == nullptr || *context == nullptr)
+        return nullptr;
+
+    auto mock = (MockContext*)*context;
+    return mock->magic == MockContextMagic ? mock : nullptr;
+}
+
+static float upscaleRatio(uint32_t qualityMode)
+{
+    switch (qualityMode)
+    {
+        case FFX_UPSCALE_QUALITY_MODE_NATIVEAA: return 1.0f;
+        case FFX_UPSCALE_QUALITY_MODE_QUALITY: return 1.5f;
+        case FFX_UPSCALE_QUALITY_MODE_BALANCED: return 1.7f;
+        case FFX_UPSCALE_QUALITY_MODE_PERFORMANCE: return 2.0f;
+        case FFX_UPSCALE_QUALITY_MODE_ULTRA_PERFORMANCE: return 3.0f;
+        default: return 0.0f;
+    }
+}
+
+static float halton(int32_t index, int32_t base)
+{
+    float f = 1.0f;
+    float result = 0.0f;
+
+    for (int32_t i = index; i > 0; i /= base)
+    {
+        f /= (float)base;
+        result += f * (float)(i % base);
+    }
+
+    return result;
+}
+
+static ffxReturnCode_t queryVersions(const ffxQueryDescGetVersions* desc)
+{
+    if (desc->outputCount == nullptr)
+        return FFX_API_RETURN_ERROR_PARAMETER;
+
+    if (*desc->outputCount > 0)
+    {
+        if (desc->versionIds != nullptr)
+            desc->versionIds[0] = MockVersionId;
+
+        if (desc->versionNames != nullptr)
+            desc->versionNames[0] = MockVersionName;
+    }
+
+    *desc->outputCount = 1;
+    return FFX_API_RETURN_OK;
+}
+
+// Same formulas as the FSR runtime, so callers size and jitter the same way
+static ffxReturnCode_t queryUpscale(const ffxQueryDescHeader* desc)
+{
+    switch (desc->type)
+    {
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETUPSCALERATIOFROMQUALITYMODE:
+        {
+            auto query = (const ffxQueryDescUpscaleGetUpscaleRatioFromQualityMode*)desc;
+            auto ratio = upscaleRatio(query->qualityMode);
+
+            if (ratio == 0.0f)
+                return FFX_API_RETURN_ERROR_PARAMETER;
+
+            if (query->pOutUpscaleRatio != nullptr)
+                *query->pOutUpscaleRatio = ratio;
+
+            return FFX_API_RETURN_OK;
+        }
+
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETRENDERRESOLUTIONFROMQUALITYMODE:
+        {
+            auto query = (const ffxQueryDescUpscaleGetRenderResolutionFromQualityMode*)desc;
+            auto ratio = upscaleRatio(query->qualityMode);
+
+            if (ratio == 0.0f)
+                return FFX_API_RETURN_ERROR_PARAMETER;
+
+            if (query->pOutRenderWidth != nullptr)
+                *query->pOutRenderWidth = (uint32_t)((float)query->displayWidth / ratio);
+
+            if (query->pOutRenderHeight != nullptr)
+                *query->pOutRenderHeight = (uint32_t)((float)query->displayHeight / ratio);
+
+            return FFX_API_RETURN_OK;
+        }
+
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETJITTERPHASECOUNT:
+        {
+            auto query = (const ffxQueryDescUpscaleGetJitterPhaseCount*)desc;
+
+            if (query->renderWidth == 0)
+                return FFX_API_RETURN_ERROR_PARAMETER;
+
+            if (query->pOutPhaseCount != nullptr)
+                *query->pOutPhaseCount = (int32_t)(8.0f * std::pow((float)query->displayWidth / (float)query->renderWidth, 2.0f));
+
+            return FFX_API_RETURN_OK;
+        }
+
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETJITTEROFFSET:
+        {
+            auto query = (const ffxQueryDescUpscaleGetJitterOffset*)desc;
+
+            if (query->phaseCount <= 0)
+                return FFX_API_RETURN_ERROR_PARAMETER;
+
+            auto index = (query->index % query->phaseCount) + 1;
+
+            if (query->pOutX != nullptr)
+                *query->pOutX = halton(index, 2) - 0.5f;
+
+            if (query->pOutY != nullptr)
+                *query->pOutY = halton(index, 3) - 0.5f;
+
+            return FFX_API_RETURN_OK;
+        }
+
+        default:
+            return FFX_API_RETURN_ERROR_UNKNOWN_DESCTYPE;
+    }
+}
+
+FFX_API_ENTRY ffxReturnCode_t ffxCreateContext(ffxContext* context, ffxCreateContextDescHeader* desc, const ffxAllocationCallbacks* memCb)
+{
+    ffxReturnCode_t result;
+    if (beginCall(FSR31MOCK_CREATE_CONTEXT, result))
+        return result;
+
+    if (context == nullptr || desc == nullptr)
+        return FFX_API_RETURN_ERROR_PARAMETER;
+
+    // Swapchain effects hand out real swapchains, the mock can't
+    auto effect = (uint32_t)(desc->type & FFX_API_EFFECT_MASK);
+    if (effect != FFX_API_EFFECT_ID_UPSCALE && effect != FFX_API_EFFECT_ID_FRAMEGENERATION)
+        return FFX_API_RETURN_NO_PROVIDER;
+
+    ffxAllocationCallbacks allocator = {};
+    if (memCb != nullptr)
+        allocator = *memCb;
+
+    auto mock = (MockContext*)(allocator.alloc != nullptr ? allocator.alloc(allocator.pUserData, sizeof(MockContext)) : malloc(sizeof(MockContext)));
+    if (mock == nullptr)
+        return FFX_API_RETURN_ERROR_MEMORY;
+
+    *mock = {};
+    mock->magic = MockContextMagic;
+    mock->effect = effect;
+    mock->allocator = allocator;
+
+    if (desc->type == FFX_API_CREATE_CONTEXT_DESC_TYPE_UPSCALE)
+    {
+        auto upscale = (const ffxCreateContextDescUpscale*)desc;
+        mock->maxRenderSize = upscale->maxRenderSize;
+        mock->maxUpscaleSize = upscale->maxUpscaleSize;
+    }
+    else if (desc->type == FFX_API_CREATE_CONTEXT_DESC_TYPE_FRAMEGENERATION)
+    {
+        auto frameGeneration = (const ffxCreateContextDescFrameGeneration*)desc;
+        mock->maxRenderSize = frameGeneration->maxRenderSize;
+        mock->maxUpscaleSize = frameGeneration->displaySize;
+    }
+
+    *context = mock;
+    _liveContexts.fetch_add(1, std::memory_order_relaxed);
+    return FFX_API_RETURN_OK;
+}
+
+FFX_API_ENTRY ffxReturnCode_t ffxDestroyContext(ffxContext* context, const ffxAllocationCallbacks*)
+{
+    ffxReturnCode_t result;
+    if (beginCall(FSR31MOCK_DESTROY_CONTEXT, result))
+        return result;
+
+    auto mock = mockContext(context);
+    if (mock == nullptr)
+        return FFX_API_RETURN_ERROR_PARAMETER;
+
+    // Freed with the callbacks it was created with, like the runtime
+    auto allocator = mock->allocator;
+    mock->magic = 0;
+
+    if (allocator.dealloc != nullptr)
+        allocator.dealloc(allocator.pUserData, mock);
+    else
+        free(mock);
+
+    *context = nullptr;
+    _liveContexts.fetch_sub(1, std::memory_order_relaxed);
+    return FFX_API_RETURN_OK;
+}
+
+FFX_API_ENTRY ffxReturnCode_t ffxConfigure(ffxContext* context, const ffxConfigureDescHeader* desc)
+{
+    ffxReturnCode_t result;
+    if (beginCall(FSR31MOCK_CONFIGURE, result))
+        return result;
+
+    if (desc == nullptr)
+        return FFX_API_RETURN_ERROR_PARAMETER;
+
+    // Global debug configuration works without a context
+    if (desc->type == FFX_API_CONFIGURE_DESC_TYPE_GLOBALDEBUG1)
+        return FFX_API_RETURN_OK;
+
+    auto mock = mockContext(context);
+    if (mock == nullptr)
+        return FFX_API_RETURN_ERROR_PARAMETER;
+
+    if ((desc->type & FFX_API_EFFECT_MASK) != mock->effect)
+        return FFX_API_RETURN_ERROR_UNKNOWN_DESCTYPE;
+
+    if (desc->type == FFX_API_CONFIGURE_DESC_TYPE_FRAMEGENERATION)
+    {
+        auto frameGeneration = (const ffxConfigureDescFrameGeneration*)desc;
+        mock->presentCallback = frameGeneration->presentCallback;
+        mock->presentCallbackUserContext = frameGeneration->presentCallbackUserContext;
+    }
+
+    return FFX_API_RETURN_OK;
+}
+
+// The runtime calls the present callback from its swapchain for every generated image and
+// then the rendered one, the mock has no swapchain and calls it right from the dispatch
+static ffxReturnCode_t presentFrames(const MockContext* mock, const ffxDispatchDescFrameGeneration* desc)
+{
+    if (mock->presentCallback == nullptr)
+        return FFX_API_RETURN_OK;
+
+    ffxCallbackDescFrameGenerationPresent present = {};
+    present.header.type = FFX_API_CALLBACK_DESC_TYPE_FRAMEGENERATION_PRESENT;
+    present.commandList = desc->commandList;
+    present.frameID = desc->frameID;
+
+    auto generated = desc->numGeneratedFrames < 4 ? desc->numGeneratedFrames : 4;
+
+    for (uint32_t i = 0; i <= generated; i++)
+    {
+        present.isGeneratedFrame = i < generated;
+        present.currentBackBuffer = present.isGeneratedFrame ? desc->outputs[i] : desc->presentColor;
+        present.outputSwapChainBuffer = present.currentBackBuffer;
+
+        auto result = mock->presentCallback(&present, mock->presentCallbackUserContext);
+        if (result != FFX_API_RETURN_OK)
+            return result;
+    }
+
+    return FFX_API_RETURN_OK;
+}
+
+FFX_API_ENTRY ffxReturnCode_t ffxQuery(ffxContext*, ffxQueryDescHeader* desc)
+{
+    ffxReturnCode_t result;
+    if (beginCall(FSR31MOCK_QUERY, result))
+        return result;
+
+    if (desc == nullptr)
+        return FFX_API_RETURN_ERROR_PARAMETER;
+
+    // Version and upscale queries are answered with or without a context
+    if (desc->type == FFX_API_QUERY_DESC_TYPE_GET_VERSIONS)
+        return queryVersions((const ffxQueryDescGetVersions*)desc);
+
+    if ((desc->type & FFX_API_EFFECT_MASK) == FFX_API_EFFECT_ID_UPSCALE)
+        return queryUpscale(desc);
+
+    return FFX_API_RETURN_ERROR_UNKNOWN_DESCTYPE;
+}
+
+FFX_API_ENTRY ffxReturnCode_t ffxDispatch(ffxContext* context, const ffxDispatchDescHeader* desc)
+{
+    ffxReturnCode_t result;
+    if (beginCall(FSR31MOCK_DISPATCH, result))
+        return result;
+
+    auto mock = mockContext(context);
+    if (mock == nullptr || desc == nullptr)
+        return FFX_API_RETURN_ERROR_PARAMETER;
+
+    if ((desc->type & FFX_API_EFFECT_MASK) != mock->effect)
+        return FFX_API_RETURN_ERROR_UNKNOWN_DESCTYPE;
+
+    if (desc->type == FFX_API_DISPATCH_DESC_TYPE_UPSCALE)
+    {
+        auto upscale = (const ffxDispatchDescUpscale*)desc;
+
+        if (upscale->renderSize.width > mock->maxRenderSize.width || upscale->renderSize.height > mock->maxRenderSize.height)
+            return FFX_API_RETURN_ERROR_PARAMETER;
+    }
+    else if (desc->type == FFX_API_DISPATCH_DESC_TYPE_FRAMEGENERATION)
+    {
+        return presentFrames(mock, (const ffxDispatchDescFrameGeneration*)desc);
+    }
+
+    return FFX_API_RETURN_OK;
+}
+
+FFX_API_ENTRY void fsr31mockSetLatency(uint32_t entry, uint64_t nanoseconds)
+{
+    if (entry < FSR31MOCK_ENTRY_COUNT)
+        _latency[entry].store(nanoseconds, std::memory_order_relaxed);
+}
+
+FFX_API_ENTRY void fsr31mockSetResult(uint32_t entry, ffxReturnCode_t result)
+{
+    if (entry < FSR31MOCK_ENTRY_COUNT)
+        _result[entry].store(result, std::memory_order_relaxed);
+}
+
+FFX_API_ENTRY uint64_t fsr31mockCallCount(uint32_t entry)
+{
+    return entry < FSR31MOCK_ENTRY_COUNT ? _calls[entry].load(std::memory_order_relaxed) : 0;
+}
+
+FFX_API_ENTRY uint64_t fsr31mockLiveContexts()
+{
+    return _liveContexts.load(std::memory_order_relaxed);
+}
+
+FFX_API_ENTRY void fsr31mockReset()
+{
+    for (uint32_t i = 0; i < FSR31MOCK_ENTRY_COUNT; i++)
+    {
+        _latency[i].store(0, std::memory_order_relaxed);
+        _result[i].store(FSR31MOCK_RESULT_DEFAULT, std::memory_order_relaxed);
+        _calls[i].store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+// fsr31mock: stand-in ffx-api provider for running the proxy without a GPU. Besides the five
+// ffx-api entry points it exports these controls, benchmarks get them with GetProcAddress/dlsym.
+#include <stdint.h>
+#include "ffx_export.h"
+#include "ffx_api.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+enum Fsr31MockEntry
+{
+    FSR31MOCK_CREATE_CONTEXT,
+    FSR31MOCK_DESTROY_CONTEXT,
+    FSR31MOCK_CONFIGURE,
+    FSR31MOCK_QUERY,
+    FSR31MOCK_DISPATCH,
+    FSR31MOCK_ENTRY_COUNT
+};
+
+// Result fsr31mockSetResult takes to go back to the mock's own answers
+#define FSR31MOCK_RESULT_DEFAULT 0xffffffffu
+
+// Busy waits this long inside every call of the entry point, 0 returns right away
+FFX_API_ENTRY void fsr31mockSetLatency(uint32_t entry, uint64_t nanoseconds);
+typedef void (*PfnFsr31mockSetLatency)(uint32_t entry, uint64_t nanoseconds);
+
+// Every call of the entry point returns result without doing anything
+FFX_API_ENTRY void fsr31mockSetResult(uint32_t entry, ffxReturnCode_t result);
+typedef void (*PfnFsr31mockSetResult)(uint32_t entry, ffxReturnCode_t result);
+
+FFX_API_ENTRY uint64_t fsr31mockCallCount(uint32_t entry);
+typedef uint64_t (*PfnFsr31mockCallCount)(uint32_t entry);
+
+FFX_API_ENTRY uint64_t fsr31mockLiveContexts();
+typedef uint64_t (*PfnFsr31mockLiveContexts)();
+
+// Back to no latency, default results and zero counts
+FFX_API_ENTRY void fsr31mockReset();
+typedef void (*PfnFsr31mockReset)();
+
+#if defined(__cplusplus)
+}
+#endif
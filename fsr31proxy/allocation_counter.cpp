@@ -0,0 +1,109 @@
+#include "pch.h"
+#include "allocation_counter.h"
+
+#ifdef FSR31PROXY_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Scopes per thread that may still allocate, e.g. first use of a thread's buffers
+constexpr uint32_t AllocationWarmup = 64;
+
+static thread_local uint64_t _allocations = 0;
+static thread_local uint32_t _scopes = 0;
+static std::atomic<uint64_t> _allocatingScopes = 0;
+
+uint64_t allocationCount()
+{
+    return _allocations;
+}
+
+uint64_t allocatingScopes()
+{
+    return _allocatingScopes.load(std::memory_order_relaxed);
+}
+
+void checkNoAllocations(uint64_t start)
+{
+    if (_scopes < AllocationWarmup)
+    {
+        _scopes++;
+        return;
+    }
+
+    if (_allocations != start)
+        _allocatingScopes.fetch_add(1, std::memory_order_relaxed);
+
+    assert(_allocations == start && "allocation on an allocation free path");
+}
+
+// On Windows the replacement only covers this dll, the game and the provider keep their own.
+// On ELF it interposes for the whole process, counts then include the provider's allocations
+// made on the calling thread.
+static void* countedAlloc(size_t size)
+{
+    _allocations++;
+
+    if (auto ptr = malloc(size != 0 ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+static void* countedAlignedAlloc(size_t size, std::align_val_t alignment) noexcept
+{
+    _allocations++;
+    auto align = (size_t)alignment;
+
+#ifdef _WIN32
+    return _aligned_malloc(size != 0 ? size : 1, align);
+#else
+    // aligned_alloc wants a multiple of the alignment
+    return aligned_alloc(align, (size + align - 1) / align * align + (size == 0 ? align : 0));
+#endif
+}
+
+static void alignedFree(void* ptr) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+static void* countedAlignedAllocOrThrow(size_t size, std::align_val_t alignment)
+{
+    if (auto ptr = countedAlignedAlloc(size, alignment))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { _allocations++; return malloc(size != 0 ? size : 1); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { _allocations++; return malloc(size != 0 ? size : 1); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void* operator new(size_t size, std::align_val_t alignment) { return countedAlignedAllocOrThrow(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return countedAlignedAllocOrThrow(size, alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAlignedAlloc(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAlignedAlloc(size, alignment); }
+void operator delete(void* ptr, std::align_val_t) noexcept { alignedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { alignedFree(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { alignedFree(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { alignedFree(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { alignedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { alignedFree(ptr); }
+
+#endif
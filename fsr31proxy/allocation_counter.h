@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+// Build with FSR31PROXY_COUNT_ALLOCATIONS to count heap allocations per thread.
+// NoAllocationScope then counts the scopes that allocated once the thread is past its first
+// few scopes, and asserts in debug builds, otherwise it compiles to nothing.
+#ifdef FSR31PROXY_COUNT_ALLOCATIONS
+
+uint64_t allocationCount();
+uint64_t allocatingScopes();
+void checkNoAllocations(uint64_t start);
+
+class NoAllocationScope
+{
+public:
+    NoAllocationScope() : _start(allocationCount()) {}
+    ~NoAllocationScope() { checkNoAllocations(_start); }
+
+    NoAllocationScope(const NoAllocationScope&) = delete;
+    NoAllocationScope& operator=(const NoAllocationScope&) = delete;
+
+private:
+    uint64_t _start;
+};
+
+#else
+
+class NoAllocationScope
+{
+public:
+    NoAllocationScope() {}
+};
+
+#endif
@@ -0,0 +1,197 @@
+#include "pch.h"
+#include "call_latency.h"
+#include "descriptors.h"
+#include "frame_stats.h"
+#include "histogram.h"
+#include "record_format.h"
+#include "timer.h"
+#include <atomic>
+#include <iterator>
+
+// 32 sub-buckets keep every percentile within 3%, 2^40 ticks is hours at any timer frequency
+using LatencyHistogram = Histogram<5, 40>;
+
+struct LatencyKey
+{
+    std::atomic<uint64_t> key{ 0 };
+    LatencyHistogram histogram;
+};
+
+static LatencyKey _keys[CallLatencyKeys];
+static std::atomic<uint64_t> _untracked{ 0 };
+
+static LatencyHistogram _overhead[(size_t)CaptureEntry::Count];
+static LatencyHistogram _frameOverhead;
+static std::atomic<uint64_t> _currentFrameOverhead{ 0 };
+
+// Entry points start at 1, so a used key is never 0
+static uint64_t latencyKey(CaptureEntry entry, uint64_t type)
+{
+    return ((uint64_t)entry << 56) | (type & 0x00ffffffffffffffull);
+}
+
+// Keys are claimed with a CAS and never released, every thread probes in the same order
+// so a key can't end up in two slots
+static LatencyHistogram* findHistogram(uint64_t key)
+{
+    auto start = (uint32_t)((key ^ (key >> 16) ^ (key >> 56)) % CallLatencyKeys);
+
+    for (uint32_t i = 0; i < CallLatencyKeys; i++)
+    {
+        auto& slot = _keys[(start + i) % CallLatencyKeys];
+        auto current = slot.key.load(std::memory_order_acquire);
+
+        if (current == 0 && slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel))
+            return &slot.histogram;
+
+        if (current == key)
+            return &slot.histogram;
+    }
+
+    return nullptr;
+}
+
+void recordCallLatency(CaptureEntry entry, uint64_t type, uint64_t ticks)
+{
+    auto histogram = findHistogram(latencyKey(entry, type));
+
+    if (histogram != nullptr)
+        histogram->record(ticks);
+    else
+        _untracked.fetch_add(1, std::memory_order_relaxed);
+}
+
+static bool endsFrame(CaptureEntry entry, uint64_t type)
+{
+    return entry == CaptureEntry::Dispatch && isFrameDispatch(type);
+}
+
+void recordProxyOverhead(CaptureEntry entry, uint64_t type, uint64_t ticks)
+{
+    _overhead[(size_t)entry].record(ticks);
+
+    auto frame = _currentFrameOverhead.fetch_add(ticks, std::memory_order_relaxed) + ticks;
+
+    // Subtracting what was read keeps time other threads added meanwhile in the next frame
+    if (endsFrame(entry, type))
+    {
+        _currentFrameOverhead.fetch_sub(frame, std::memory_order_relaxed);
+        _frameOverhead.record(frame);
+    }
+}
+
+// Microseconds with one decimal, enough for a provider call
+static void appendMicros(FormatBuffer& out, uint64_t ticks)
+{
+    auto nanos = timerToNanoseconds(ticks);
+    out.appendNumber(nanos / 1000).append('.').appendNumber((nanos / 100) % 10).append(" us");
+}
+
+static void appendPercentiles(FormatBuffer& out, const LatencyHistogram& histogram)
+{
+    out.append("p50 ");
+    appendMicros(out, histogram.percentile(0.5));
+    out.append(", p99 ");
+    appendMicros(out, histogram.percentile(0.99));
+    out.append(", p99.9 ");
+    appendMicros(out, histogram.percentile(0.999));
+    out.append(", max ");
+    appendMicros(out, histogram.max());
+}
+
+static uint64_t providerTime(CaptureEntry entry)
+{
+    uint64_t total = 0;
+
+    for (auto& slot : _keys)
+    {
+        auto key = slot.key.load(std::memory_order_acquire);
+
+        if (key != 0 && (CaptureEntry)(key >> 56) == entry)
+            total += slot.histogram.sum();
+    }
+
+    return total;
+}
+
+static void reportOverhead(FormatBuffer& out, std::string_view time)
+{
+    for (size_t i = 0; i < std::size(_overhead); i++)
+    {
+        auto& histogram = _overhead[i];
+        auto entry = (CaptureEntry)i;
+
+        if (histogram.count() == 0)
+            continue;
+
+        out.append('[').append(time).append("] overhead ").append(entryName(entry)).append(": ").appendNumber(histogram.count()).append(" calls, ");
+        appendPercentiles(out, histogram);
+        out.append(", total ");
+        appendMicros(out, histogram.sum());
+
+        // Hundredths of a percent of the time spent in the provider for the same calls
+        auto provider = providerTime(entry);
+
+        if (provider > 0)
+        {
+            auto share = histogram.sum() * 10000 / provider;
+            out.append(", ").appendNumber(share / 100).append('.').appendNumber(share / 10 % 10).appendNumber(share % 10).append("% of provider time");
+        }
+
+        out.append('\n');
+    }
+
+    if (_frameOverhead.count() > 0)
+    {
+        out.append('[').append(time).append("] overhead per frame: ").appendNumber(_frameOverhead.count()).append(" frames, ");
+        appendPercentiles(out, _frameOverhead);
+        out.append('\n');
+    }
+}
+
+void resetCallLatency()
+{
+    for (auto& slot : _keys)
+        slot.histogram.reset();
+
+    for (auto& histogram : _overhead)
+        histogram.reset();
+
+    _untracked.store(0, std::memory_order_relaxed);
+    _frameOverhead.reset();
+    _currentFrameOverhead.store(0, std::memory_order_relaxed);
+}
+
+void reportCallLatency(FormatBuffer& out, std::string_view time)
+{
+    for (auto& slot : _keys)
+    {
+        auto key = slot.key.load(std::memory_order_acquire);
+        auto& histogram = slot.histogram;
+
+        if (key == 0 || histogram.count() == 0)
+            continue;
+
+        auto type = key & 0x00ffffffffffffffull;
+        auto typeName = descriptorName(type);
+
+        out.append('[').append(time).append("] latency ").append(entryName((CaptureEntry)(key >> 56)));
+
+        // Destroy has no descriptor
+        if (typeName != nullptr)
+            out.append(' ').append(typeName);
+        else if (type != 0)
+            out.append(' ').appendNumber(type);
+
+        out.append(": ").appendNumber(histogram.count()).append(" calls, ");
+        appendPercentiles(out, histogram);
+        out.append('\n');
+    }
+
+    auto untracked = _untracked.load(std::memory_order_relaxed);
+
+    if (untracked > 0)
+        out.append('[').append(time).append("] latency: ").appendNumber(untracked).append(" calls of untracked types\n");
+
+    reportOverhead(out, time);
+}
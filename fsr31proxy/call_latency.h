@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include "format_buffer.h"
+#include "trace_format.h"
+
+// Distinct entry point and descriptor type pairs that get a histogram, later ones are only counted
+constexpr uint32_t CallLatencyKeys = 64;
+
+// Seconds between the latency reports the capture writer appends to the text log
+constexpr uint32_t CallLatencyReportInterval = 60;
+
+// Time spent in the provider for one forwarded call, in timer ticks. Destroy calls use type 0.
+void recordCallLatency(CaptureEntry entry, uint64_t type, uint64_t ticks);
+
+// The proxy's own time in an exported function outside of the forwarded call: latency
+// recording, context tracking, chain walking and capture. A frame ends with every upscale
+// dispatch, or with every frame generation prepare dispatch for apps that don't upscale.
+void recordProxyOverhead(CaptureEntry entry, uint64_t type, uint64_t ticks);
+
+// One line per entry point and type with p50/p99/p99.9/max since the proxy was loaded or the
+// last reset, followed by the proxy overhead per entry point and per frame
+void reportCallLatency(FormatBuffer& out, std::string_view time);
+
+// Empties the histograms, the entry point and type pairs keep their slots
+void resetCallLatency();
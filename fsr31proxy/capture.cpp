@@ -0,0 +1,654 @@
+#include "pch.h"
+#include "capture.h"
+#include "allocation_counter.h"
+#include "call_latency.h"
+#include "config.h"
+#include "context_registry.h"
+#include "frame_ids.h"
+#include "frame_stats.h"
+#include "log.h"
+#include "provider.h"
+#include "query_cache.h"
+#include "descriptor_chain.h"
+#include "descriptors.h"
+#include "file_sink.h"
+#include "record_format.h"
+#include "ring_buffer.h"
+#include "startup.h"
+#include "timer.h"
+#include "ffx_upscale.h"
+#include "ffx_framegeneration.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// Every thread that captures gets its own single-producer ring, the writer merges them
+// back into call order by sequence number. Slots are reused after the thread exits.
+constexpr size_t CaptureThreadCount = 32;
+constexpr size_t CaptureThreadRingSize = 512;
+
+enum class CaptureThreadState : uint32_t
+{
+    Free,
+    Active,
+    Released
+};
+
+struct CaptureThread
+{
+    RingBuffer<CaptureRecord, CaptureThreadRingSize> ring;
+    std::atomic<CaptureThreadState> state = CaptureThreadState::Free;
+    uint32_t threadId = 0;
+    // Only written by the owning thread
+    std::atomic<uint64_t> captured = 0;
+    std::atomic<uint64_t> dropped = 0;
+    std::atomic<uint64_t> skipped = 0;
+};
+
+static CaptureThread _threads[CaptureThreadCount];
+static std::atomic<uint32_t> _threadCount = 0;
+static std::atomic<uint64_t> _sequence = 0;
+static std::atomic<uint64_t> _unregistered = 0;
+static thread_local CaptureThread* _thread = nullptr;
+
+static thread_local uint32_t _dispatchCounts[8] = {};
+
+static std::atomic<bool> _capturing = false;
+static std::atomic<bool> _writerRunning = false;
+static std::atomic<bool> _writerDone = false;
+static std::atomic<uint64_t> _flushRequests = 0;
+static std::atomic<uint64_t> _flushesDone = 0;
+static FileSink* _textOutput = nullptr;
+static FileSink* _traceOutput = nullptr;
+static std::thread _writer;
+
+// Writer side merge state
+static uint64_t _nextSequence = 0;
+static uint64_t _gapStart = 0;
+static std::atomic<uint64_t> _gapsSkipped = 0;
+static std::atomic<uint64_t> _written = 0;
+static DescriptorDeltas _deltas;
+static FormatBuffer _text;
+
+static uint32_t currentThreadId()
+{
+#ifdef _WIN32
+    return GetCurrentThreadId();
+#else
+    return (uint32_t)gettid();
+#endif
+}
+
+#ifndef _WIN32
+// There is no DLL_THREAD_DETACH outside of Windows, a thread_local destructor hands the slot back
+struct CaptureThreadGuard
+{
+    ~CaptureThreadGuard() { releaseCaptureThread(); }
+};
+
+static thread_local CaptureThreadGuard _threadGuard;
+#endif
+
+static CaptureThread* registerThread()
+{
+    for (uint32_t i = 0; i < CaptureThreadCount; i++)
+    {
+        auto expected = CaptureThreadState::Free;
+
+        if (!_threads[i].state.compare_exchange_strong(expected, CaptureThreadState::Active, std::memory_order_acquire))
+            continue;
+
+        _threads[i].threadId = currentThreadId();
+
+        // Writer only scans slots below the high-water mark
+        auto count = _threadCount.load(std::memory_order_relaxed);
+        while (count < i + 1 && !_threadCount.compare_exchange_weak(count, i + 1, std::memory_order_release))
+            ;
+
+        _thread = &_threads[i];
+
+#ifndef _WIN32
+        // First use constructs the guard on this thread
+        (void)&_threadGuard;
+#endif
+
+        return _thread;
+    }
+
+    return nullptr;
+}
+
+void releaseCaptureThread()
+{
+    // Writer frees the slot once the remaining records are written
+    if (_thread != nullptr)
+    {
+        _thread->state.store(CaptureThreadState::Released, std::memory_order_release);
+        _thread = nullptr;
+    }
+}
+
+// Space is reserved before the sequence number is taken, so every sequence handed out
+// is eventually published and the writer only ever waits for records in flight.
+static CaptureThread* currentThread()
+{
+    auto thread = _thread != nullptr ? _thread : registerThread();
+
+    if (thread == nullptr)
+        _unregistered.fetch_add(1, std::memory_order_relaxed);
+
+    return thread;
+}
+
+static void countRecord(std::atomic<uint64_t>& counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+template <typename F>
+static void pushRecord(F&& fill)
+{
+    auto thread = currentThread();
+
+    if (thread == nullptr)
+        return;
+
+    bool pushed = thread->ring.tryPush([&](CaptureRecord& record)
+    {
+        fill(record);
+        record.header.threadId = thread->threadId;
+        record.header.sequence = _sequence.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    countRecord(pushed ? thread->captured : thread->dropped);
+}
+
+static void pushMessage(const char* text, size_t length)
+{
+    auto timestamp = timerNow();
+
+    pushRecord([&](CaptureRecord& record)
+    {
+        if (length > sizeof(record.payload))
+            length = sizeof(record.payload);
+
+        record.header = {};
+        record.header.timestamp = timestamp;
+        record.header.endTimestamp = timestamp;
+        record.header.entry = CaptureEntry::Message;
+        record.header.size = (uint16_t)length;
+        memcpy(record.payload, text, length);
+    });
+}
+
+void captureMessage(const char* text, size_t length)
+{
+    if (_capturing.load(std::memory_order_relaxed))
+        pushMessage(text, length);
+}
+
+static uint32_t entryCategory(CaptureEntry entry)
+{
+    switch (entry)
+    {
+        case CaptureEntry::CreateContext: return LogCategoryCreate;
+        case CaptureEntry::DestroyContext: return LogCategoryDestroy;
+        case CaptureEntry::Configure: return LogCategoryConfigure;
+        case CaptureEntry::Query: return LogCategoryQuery;
+        case CaptureEntry::Dispatch: return LogCategoryDispatch;
+        default: return LogCategoryGeneral;
+    }
+}
+
+static uint32_t effectCategory(uint64_t type)
+{
+    switch (type & FFX_API_EFFECT_MASK)
+    {
+        case FFX_API_EFFECT_ID_GENERAL: return LogCategoryGlobal;
+        case FFX_API_EFFECT_ID_UPSCALE: return LogCategoryUpscale;
+        case FFX_API_EFFECT_ID_FRAMEGENERATION: return LogCategoryFrameGeneration;
+        default: return LogCategorySwapChain;
+    }
+}
+
+static uint32_t callCategories(CaptureEntry entry, const ffxApiHeader* desc)
+{
+    return entryCategory(entry) | (desc != nullptr ? effectCategory(desc->type) : 0);
+}
+
+static bool dispatchReset(const ffxApiHeader* desc)
+{
+    switch (desc->type)
+    {
+        case FFX_API_DISPATCH_DESC_TYPE_UPSCALE: return ((const ffxDispatchDescUpscale*)desc)->reset;
+        case FFX_API_DISPATCH_DESC_TYPE_FRAMEGENERATION: return ((const ffxDispatchDescFrameGeneration*)desc)->reset;
+        default: return false;
+    }
+}
+
+// Frames with reset are always kept, counting is per thread and dispatch type
+static bool sampleDispatch(const ProxyConfig& config, const ffxApiHeader* desc)
+{
+    auto sampling = config.sampling;
+
+    if (sampling == CaptureSampling::All || desc == nullptr || dispatchReset(desc))
+        return true;
+
+    if (sampling == CaptureSampling::ResetOnly)
+        return false;
+
+    auto& count = _dispatchCounts[(desc->type ^ (desc->type >> 16)) & 7];
+    return count++ % config.sampleInterval == 0;
+}
+
+void captureCall(CaptureEntry entry, ffxContext context, const ffxApiHeader* desc, uint64_t timestamp, uint64_t endTimestamp, ffxReturnCode_t result, uint32_t flags)
+{
+    if (!_capturing.load(std::memory_order_relaxed))
+        return;
+
+    NoAllocationScope noAllocations;
+
+    // Failed calls are errors, everything else is info. Both checks fold away when compiled out.
+    auto level = result == FFX_API_RETURN_OK ? LogLevel::Info : LogLevel::Error;
+    if (!logEnabled(level, callCategories(entry, desc)))
+        return;
+
+    // One snapshot for the whole call, a reload in between can't mix two of them
+    auto& config = proxyConfig();
+
+    if (!config.capture)
+        return;
+
+    if (entry == CaptureEntry::Dispatch && result == FFX_API_RETURN_OK && !sampleDispatch(config, desc))
+    {
+        if (auto thread = currentThread())
+            countRecord(thread->skipped);
+
+        return;
+    }
+
+    pushRecord([&](CaptureRecord& record)
+    {
+        record.header = {};
+        record.header.timestamp = timestamp;
+        record.header.endTimestamp = endTimestamp;
+        record.header.context = (uint64_t)(uintptr_t)context;
+        record.header.result = result;
+        record.header.entry = entry;
+        record.header.flags = flags;
+
+        size_t offset = 0;
+
+        auto end = walkDescriptorChain(desc, [&](const ffxApiHeader* header)
+        {
+            auto size = descriptorSize(header->type);
+            auto padded = capturePadding(size);
+
+            if (offset + sizeof(CaptureDescriptor) + padded > sizeof(record.payload))
+                return false;
+
+            CaptureDescriptor descriptor = { header->type, (uint32_t)size, 0 };
+            memcpy(record.payload + offset, &descriptor, sizeof(descriptor));
+            memcpy(record.payload + offset + sizeof(descriptor), header, size);
+            offset += sizeof(descriptor) + padded;
+            record.header.descriptorCount++;
+            return true;
+        });
+
+        if (end == ChainEnd::Cycle)
+            record.header.flags |= CaptureFlagChainCycle;
+        else if (end != ChainEnd::Complete)
+            record.header.flags |= CaptureFlagChainTruncated;
+
+        record.header.size = (uint16_t)offset;
+    });
+}
+
+static void writeRecord(const CaptureRecord& record)
+{
+    if (_textOutput != nullptr)
+    {
+        // Descriptor contents are verbose and only go to the text log when there is no trace
+        bool fields = false;
+
+        if (_traceOutput == nullptr && record.header.entry != CaptureEntry::Message && record.header.descriptorCount > 0)
+        {
+            CaptureDescriptor descriptor;
+            memcpy(&descriptor, record.payload, sizeof(descriptor));
+            fields = logEnabled<LogLevel::Verbose>(entryCategory(record.header.entry) | effectCategory(descriptor.type));
+        }
+
+        char time[32];
+        char endTime[32];
+        auto timeLength = timerFormat(record.header.timestamp, time, sizeof(time));
+        auto endTimeLength = timerFormat(record.header.endTimestamp, endTime, sizeof(endTime));
+
+        // Segment rotation in the sink may allocate, formatting may not
+        {
+            NoAllocationScope noAllocations;
+            _text.clear();
+            _deltas.keyframeInterval = proxyConfig().keyframeInterval;
+            formatRecordText(_text, record, std::string_view(time, timeLength), std::string_view(endTime, endTimeLength), fields, descriptorName, &_deltas);
+        }
+
+        _textOutput->write(_text.data(), _text.size());
+    }
+
+    if (_traceOutput != nullptr)
+    {
+        // Copied straight into the mapped segment, a record never spans two segments. Always the
+        // full descriptors, deltas are only for the text, sampling is what makes the trace smaller.
+        auto size = sizeof(record.header) + record.header.size;
+        auto target = _traceOutput->reserve(size);
+
+        if (target != nullptr)
+        {
+            memcpy(target, &record.header, sizeof(record.header));
+            memcpy(target + sizeof(record.header), record.payload, record.header.size);
+            _traceOutput->commit(size);
+        }
+    }
+}
+
+// Oldest record across all thread rings, frees slots of exited threads on the way
+static const CaptureRecord* nextRecord(CaptureThread*& owner)
+{
+    const CaptureRecord* next = nullptr;
+    auto count = _threadCount.load(std::memory_order_acquire);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        auto& thread = _threads[i];
+        auto state = thread.state.load(std::memory_order_acquire);
+
+        if (state == CaptureThreadState::Free)
+            continue;
+
+        auto record = thread.ring.peek();
+
+        if (record == nullptr)
+        {
+            if (state == CaptureThreadState::Released)
+                thread.state.store(CaptureThreadState::Free, std::memory_order_release);
+
+            continue;
+        }
+
+        if (next == nullptr || record->header.sequence < next->header.sequence)
+        {
+            next = record;
+            owner = &thread;
+        }
+    }
+
+    return next;
+}
+
+// Writes records in sequence order. A missing sequence is a record another thread is
+// still filling, wait for it a while unless flushing, a thread killed mid-push would
+// otherwise stall the capture forever.
+static size_t drainRing(bool flush)
+{
+    size_t count = 0;
+    CaptureThread* owner = nullptr;
+
+    while (auto record = nextRecord(owner))
+    {
+        if (record->header.sequence > _nextSequence && !flush)
+        {
+            auto now = timerNow();
+
+            if (_gapStart == 0)
+                _gapStart = now;
+
+            if (now - _gapStart < timerFrequency() / 10)
+                break;
+
+            countRecord(_gapsSkipped);
+        }
+
+        _gapStart = 0;
+        _nextSequence = record->header.sequence + 1;
+        writeRecord(*record);
+        owner->ring.pop();
+        countRecord(_written);
+        count++;
+    }
+
+    return count;
+}
+
+// Per-event cost of the timing path, logged once so captures can be compared across machines
+static void measureTimer()
+{
+    if (!logEnabled<LogLevel::Info>(LogCategoryGeneral))
+        return;
+
+    constexpr int iterations = 1000;
+    char buffer[32];
+
+    auto start = timerNow();
+    for (int i = 0; i < iterations; i++)
+        buffer[0] = (char)timerNow();
+    auto now = timerNow() - start;
+
+    start = timerNow();
+    for (int i = 0; i < iterations; i++)
+        timerFormat(start + i, buffer, sizeof(buffer));
+    auto format = timerNow() - start;
+
+    _text.clear();
+    _text.append("timer: ").appendNumber(timerFrequency()).append(" Hz, timerNow ").appendNumber(timerToNanoseconds(now) / iterations);
+    _text.append(" ns, timerFormat ").appendNumber(timerToNanoseconds(format) / iterations).append(" ns per event");
+    pushMessage(_text.data(), _text.size());
+}
+
+static void writeReports()
+{
+    if (_textOutput == nullptr)
+        return;
+
+    char time[32];
+    auto timeLength = timerFormat(timerNow(), time, sizeof(time));
+
+    _text.clear();
+    reportCallLatency(_text, std::string_view(time, timeLength));
+    reportFrameStats(_text, std::string_view(time, timeLength));
+    reportFrameIds(_text, std::string_view(time, timeLength));
+    reportQueryCache(_text, std::string_view(time, timeLength));
+    reportStartupTimeline(_text, std::string_view(time, timeLength));
+    reportProvider(_text, std::string_view(time, timeLength));
+    _textOutput->write(_text.data(), _text.size());
+}
+
+static void writerThread()
+{
+    measureTimer();
+
+    auto reportInterval = timerFrequency() * CallLatencyReportInterval;
+    auto lastReport = timerNow();
+
+    while (_writerRunning.load(std::memory_order_acquire))
+    {
+        if (drainRing(false) == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+        // Records in flight on other threads are written as they arrive, like at stop
+        auto flushes = _flushRequests.load(std::memory_order_acquire);
+
+        if (flushes != _flushesDone.load(std::memory_order_relaxed))
+        {
+            drainRing(true);
+            writeReports();
+            lastReport = timerNow();
+            _flushesDone.store(flushes, std::memory_order_release);
+        }
+        else if (timerNow() - lastReport >= reportInterval)
+        {
+            writeReports();
+            lastReport = timerNow();
+        }
+    }
+
+    drainRing(true);
+    _writerDone.store(true, std::memory_order_release);
+}
+
+static std::string traceHeader()
+{
+    auto descriptors = knownDescriptors();
+    auto entryCount = (uint32_t)CaptureEntry::Count;
+
+    TraceFileHeader header = {};
+    memcpy(header.magic, TraceMagic, sizeof(header.magic));
+    header.version = TraceVersion;
+    header.headerSize = (uint32_t)(sizeof(TraceFileHeader) + (entryCount + descriptors.size()) * sizeof(TraceNameEntry));
+    header.recordHeaderSize = sizeof(CaptureRecordHeader);
+    header.maxPayloadSize = sizeof(CaptureRecord::payload);
+    header.pointerSize = sizeof(void*);
+    header.entryCount = entryCount;
+    header.typeCount = (uint32_t)descriptors.size();
+    header.timestampFrequency = timerFrequency();
+    header.startTimestamp = timerStart();
+    header.startTime = timerStartTime();
+    std::string out((const char*)&header, sizeof(header));
+
+    for (uint32_t i = 0; i < entryCount; i++)
+    {
+        TraceNameEntry entry = {};
+        entry.id = i;
+        strncpy(entry.name, entryName((CaptureEntry)i), sizeof(entry.name) - 1);
+        out.append((const char*)&entry, sizeof(entry));
+    }
+
+    for (auto& info : descriptors)
+    {
+        TraceNameEntry entry = {};
+        entry.id = info.type;
+        entry.size = info.size;
+        strncpy(entry.name, info.name, sizeof(entry.name) - 1);
+        out.append((const char*)&entry, sizeof(entry));
+    }
+
+    return out;
+}
+
+void startCapture(FileSink* textOutput, FileSink* traceOutput)
+{
+    if (_capturing.load() || (textOutput == nullptr && traceOutput == nullptr))
+        return;
+
+    _textOutput = textOutput;
+    _traceOutput = traceOutput;
+
+    // Every trace segment starts with the header so it can be decoded on its own
+    if (_traceOutput != nullptr)
+    {
+        _traceOutput->setPreamble(traceHeader());
+    }
+
+    _writerDone.store(false);
+    _writerRunning.store(true);
+    _capturing.store(true);
+    _writer = std::thread(writerThread);
+}
+
+bool flushCapture()
+{
+    if (!_capturing.load())
+        return false;
+
+    auto request = _flushRequests.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+    for (uint32_t i = 0; i < CaptureFlushTimeout; i++)
+    {
+        if (_flushesDone.load(std::memory_order_acquire) >= request)
+            return true;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return false;
+}
+
+CaptureStats captureStats()
+{
+    CaptureStats stats = {};
+    stats.dropped = _unregistered.load();
+    stats.written = _written.load();
+    stats.outOfOrder = _gapsSkipped.load();
+
+    for (uint32_t i = 0; i < _threadCount.load(); i++)
+    {
+        stats.captured += _threads[i].captured.load();
+        stats.dropped += _threads[i].dropped.load();
+        stats.skipped += _threads[i].skipped.load();
+
+        if (_threads[i].captured.load() > 0)
+            stats.threads++;
+    }
+
+    return stats;
+}
+
+static void writeSummary()
+{
+    if (_textOutput != nullptr)
+    {
+        auto stats = captureStats();
+
+        char time[32];
+        auto timeLength = timerFormat(timerNow(), time, sizeof(time));
+
+        _text.clear();
+        _text.append('[').append(std::string_view(time, timeLength)).append("] capture: ").appendNumber(stats.captured).append(" records from ").appendNumber(stats.threads);
+        _text.append(" threads, ").appendNumber(stats.dropped).append(" dropped, ").appendNumber(stats.skipped).append(" sampled out, ").appendNumber(stats.outOfOrder).append(" out of order\n");
+        reportContexts(_text, std::string_view(time, timeLength));
+        reportCallLatency(_text, std::string_view(time, timeLength));
+        reportFrameStats(_text, std::string_view(time, timeLength));
+        reportFrameIds(_text, std::string_view(time, timeLength));
+        reportQueryCache(_text, std::string_view(time, timeLength));
+        reportStartupTimeline(_text, std::string_view(time, timeLength));
+        reportProvider(_text, std::string_view(time, timeLength));
+        _textOutput->write(_text.data(), _text.size());
+    }
+}
+
+void stopCapture()
+{
+    if (!_capturing.exchange(false))
+        return;
+
+    // The writer drains the rings a last time before it exits
+    _writerRunning.store(false, std::memory_order_release);
+
+    if (_writer.joinable())
+        _writer.join();
+
+    writeSummary();
+}
+
+void abandonCapture()
+{
+    if (!_capturing.exchange(false))
+        return;
+
+    _writerRunning.store(false, std::memory_order_release);
+
+    if (!_writerDone.load(std::memory_order_acquire))
+        drainRing(true);
+
+    // The thread is gone, only its handle is left
+    if (_writer.joinable())
+        _writer.detach();
+
+    writeSummary();
+}
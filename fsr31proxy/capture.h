@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include "ffx_api.h"
+#include "trace_format.h"
+
+class FileSink;
+
+// Hot path, only copies raw bytes into the calling thread's ring buffer
+void captureMessage(const char* text, size_t length);
+void captureCall(CaptureEntry entry, ffxContext context, const ffxApiHeader* desc, uint64_t timestamp, uint64_t endTimestamp, ffxReturnCode_t result, uint32_t flags = 0);
+
+// Set in the config, decided on the calling thread. Only successful dispatches are sampled.
+enum class CaptureSampling : uint32_t
+{
+    All,
+    EveryNth,       // every interval-th dispatch of each type, plus frames with reset
+    ResetOnly,      // only dispatches with reset set
+};
+
+// Descriptor fields in the text log are written in full every this many calls per context
+// and descriptor type by default and only the changed ones in between, 0 writes every call in full
+constexpr uint32_t CaptureKeyframeInterval = 60;
+
+// Each capturing thread owns a ring, called on thread exit so the slot can be reused
+void releaseCaptureThread();
+
+// Starts/stops the background writer. Records are formatted as text into textOutput and
+// written verbatim into traceOutput, either one may be null. When a trace is written the
+// text output only gets the call summaries, the descriptor contents live in the trace.
+// stopCapture joins the writer, never from DllMain.
+void startCapture(FileSink* textOutput, FileSink* traceOutput);
+void stopCapture();
+
+// At process exit, when the writer was already killed with every other thread. What is left
+// in the rings is written on the calling thread, the only one still touching them.
+void abandonCapture();
+
+// Has the writer write every record captured so far followed by the reports, waits up to
+// CaptureFlushTimeout milliseconds for it. False when it didn't get to it or isn't running.
+constexpr uint32_t CaptureFlushTimeout = 1000;
+bool flushCapture();
+
+struct CaptureStats
+{
+    uint64_t captured;          // pushed into a thread's ring
+    uint64_t dropped;           // the ring was full or every ring was taken
+    uint64_t skipped;           // sampled out
+    uint64_t written;           // taken out of the rings by the writer
+    uint64_t outOfOrder;        // missing sequences the writer stopped waiting for
+    uint32_t threads;           // threads that captured anything
+};
+
+// Totals since the proxy loaded. Written catches up with captured after a flush or stop.
+CaptureStats captureStats();
@@ -0,0 +1,438 @@
+#include "pch.h"
+#include "config.h"
+#include "provider.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static const ProxyConfig _defaults;
+static std::atomic<const ProxyConfig*> _current{ &_defaults };
+
+// Every distinct snapshot published, a caller may still hold a reference to an old one.
+// Publishing settings seen before reuses their snapshot, so toggling control keys or editing
+// the file back and forth doesn't keep adding snapshots.
+static std::mutex _lock;
+static std::vector<std::unique_ptr<ProxyConfig>> _snapshots;
+static std::string _path;
+
+static std::atomic<bool> _watcherRunning = false;
+static std::thread _watcher;
+
+struct NamedValue
+{
+    const char* name;
+    uint32_t value;
+};
+
+static const NamedValue _levels[] = {
+    { "off", (uint32_t)LogLevel::Off },
+    { "error", (uint32_t)LogLevel::Error },
+    { "warning", (uint32_t)LogLevel::Warning },
+    { "info", (uint32_t)LogLevel::Info },
+    { "verbose", (uint32_t)LogLevel::Verbose },
+};
+
+static const NamedValue _categories[] = {
+    { "general", LogCategoryGeneral },
+    { "create", LogCategoryCreate },
+    { "destroy", LogCategoryDestroy },
+    { "configure", LogCategoryConfigure },
+    { "query", LogCategoryQuery },
+    { "dispatch", LogCategoryDispatch },
+    { "global", LogCategoryGlobal },
+    { "upscale", LogCategoryUpscale },
+    { "framegeneration", LogCategoryFrameGeneration },
+    { "swapchain", LogCategorySwapChain },
+    { "all", LogCategoryAll },
+};
+
+static const NamedValue _samplings[] = {
+    { "all", (uint32_t)CaptureSampling::All },
+    { "every", (uint32_t)CaptureSampling::EveryNth },
+    { "reset", (uint32_t)CaptureSampling::ResetOnly },
+};
+
+static const NamedValue _queryCacheModes[] = {
+    { "off", (uint32_t)QueryCacheMode::Off },
+    { "0", (uint32_t)QueryCacheMode::Off },
+    { "on", (uint32_t)QueryCacheMode::On },
+    { "1", (uint32_t)QueryCacheMode::On },
+    { "verify", (uint32_t)QueryCacheMode::Verify },
+};
+
+static const NamedValue _switches[] = {
+    { "off", 0 },
+    { "0", 0 },
+    { "false", 0 },
+    { "on", 1 },
+    { "1", 1 },
+    { "true", 1 },
+};
+
+template <size_t Count>
+static bool findValue(const NamedValue (&values)[Count], const std::string& name, uint32_t& value)
+{
+    for (auto& named : values)
+    {
+        if (name == named.name)
+        {
+            value = named.value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static std::string trim(const std::string& text)
+{
+    auto begin = text.find_first_not_of(" \t\r\n");
+
+    if (begin == std::string::npos)
+        return "";
+
+    return text.substr(begin, text.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+static std::string lower(std::string text)
+{
+    for (auto& c : text)
+    {
+        if (c >= 'A' && c <= 'Z')
+            c = (char)(c - 'A' + 'a');
+    }
+
+    return text;
+}
+
+static bool parseNumber(const std::string& text, uint32_t& value)
+{
+    if (text.empty())
+        return false;
+
+    char* end = nullptr;
+    auto number = strtoul(text.c_str(), &end, 0);
+
+    if (end == nullptr || *end != 0 || number > UINT32_MAX)
+        return false;
+
+    value = (uint32_t)number;
+    return true;
+}
+
+// A number or names separated by commas
+static bool parseCategories(const std::string& text, uint32_t& categories)
+{
+    if (parseNumber(text, categories))
+        return true;
+
+    categories = 0;
+    size_t begin = 0;
+
+    while (begin <= text.size())
+    {
+        auto end = text.find(',', begin);
+        end = end != std::string::npos ? end : text.size();
+
+        uint32_t category;
+        if (!findValue(_categories, trim(text.substr(begin, end - begin)), category))
+            return false;
+
+        categories |= category;
+        begin = end + 1;
+    }
+
+    return true;
+}
+
+// Returns false for an unknown key or a value it can't use
+static bool applyValue(ProxyConfig& config, const std::string& section, const std::string& key, const std::string& value)
+{
+    uint32_t number;
+    auto name = lower(value);
+
+    if (section == "log")
+    {
+        if (key == "file")
+            config.logFile = value;
+        else if (key == "trace")
+            config.traceFile = value;
+        else if (key == "level" && (findValue(_levels, name, number) || (parseNumber(name, number) && number <= (uint32_t)LogLevel::Verbose)))
+            config.logLevel = (LogLevel)number;
+        else if (key == "categories" && parseCategories(name, number))
+            config.logCategories = number;
+        else
+            return false;
+    }
+    else if (section == "capture")
+    {
+        if (key == "enabled" && findValue(_switches, name, number))
+            config.capture = number != 0;
+        else if (key == "sampling" && findValue(_samplings, name, number))
+            config.sampling = (CaptureSampling)number;
+        else if (key == "interval" && parseNumber(name, number) && number > 0)
+            config.sampleInterval = number;
+        else if (key == "keyframes" && parseNumber(name, number) && number > 0)
+            config.keyframeInterval = number;
+        else
+            return false;
+    }
+    else if (section == "cache")
+    {
+        if (key == "queries" && findValue(_queryCacheModes, name, number))
+            config.queryCache = (QueryCacheMode)number;
+        else if (key == "versions" && findValue(_switches, name, number))
+            config.versionCache = number != 0;
+        else
+            return false;
+    }
+    else if (section == "provider")
+    {
+        if (key == "file" && !value.empty())
+            config.providerFile = value;
+        else
+            return false;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+static void readFile(ProxyConfig& config)
+{
+    std::ifstream input(_path);
+    if (!input.is_open())
+        return;
+
+    config.path = _path;
+
+    std::string line;
+    std::string section;
+
+    for (uint32_t number = 1; std::getline(input, line); number++)
+    {
+        // Comments also follow values after a blank
+        auto comment = line.find_first_of(";#");
+        while (comment != std::string::npos && comment > 0 && line[comment - 1] != ' ' && line[comment - 1] != '\t')
+            comment = line.find_first_of(";#", comment + 1);
+
+        line = trim(line.substr(0, comment));
+
+        if (line.empty())
+            continue;
+
+        if (line.front() == '[' && line.back() == ']')
+        {
+            section = lower(trim(line.substr(1, line.size() - 2)));
+            continue;
+        }
+
+        auto equals = line.find('=');
+
+        if (equals == std::string::npos || !applyValue(config, section, lower(trim(line.substr(0, equals))), trim(line.substr(equals + 1))))
+            config.problems += "line " + std::to_string(number) + " ignored: " + line + "\n";
+    }
+}
+
+// Variables used before there was a file still win over it
+static void readEnvironment(ProxyConfig& config)
+{
+    auto provider = getenv("FSR31PROXY_PROVIDER");
+    if (provider != nullptr && provider[0] != 0)
+        config.providerFile = provider;
+
+    uint32_t number;
+
+    auto queryCache = getenv("FSR31PROXY_QUERY_CACHE");
+    if (queryCache != nullptr && queryCache[0] != 0 && findValue(_queryCacheModes, lower(queryCache), number))
+        config.queryCache = (QueryCacheMode)number;
+
+    auto versionCache = getenv("FSR31PROXY_VERSION_CACHE");
+    if (versionCache != nullptr && versionCache[0] != 0 && findValue(_switches, lower(versionCache), number))
+        config.versionCache = number != 0;
+}
+
+// Everything but the generation
+static bool sameSettings(const ProxyConfig& a, const ProxyConfig& b)
+{
+    return a.logFile == b.logFile && a.traceFile == b.traceFile && a.logLevel == b.logLevel && a.logCategories == b.logCategories &&
+        a.capture == b.capture && a.sampling == b.sampling && a.sampleInterval == b.sampleInterval && a.keyframeInterval == b.keyframeInterval &&
+        a.queryCache == b.queryCache && a.versionCache == b.versionCache && a.providerFile == b.providerFile &&
+        a.path == b.path && a.problems == b.problems;
+}
+
+// Needs _lock
+static const ProxyConfig* publish(std::unique_ptr<ProxyConfig> config)
+{
+    const ProxyConfig* published = nullptr;
+
+    for (auto& snapshot : _snapshots)
+    {
+        if (sameSettings(*snapshot, *config))
+            published = snapshot.get();
+    }
+
+    if (published == nullptr)
+    {
+        config->generation = _snapshots.size() + 1;
+        _snapshots.push_back(std::move(config));
+        published = _snapshots.back().get();
+    }
+
+    _current.store(published, std::memory_order_release);
+
+    setLogLevel(published->logLevel);
+    setLogCategories(published->logCategories);
+
+    return published;
+}
+
+static std::unique_ptr<ProxyConfig> buildConfig()
+{
+    auto config = std::make_unique<ProxyConfig>();
+    readFile(*config);
+    readEnvironment(*config);
+    return config;
+}
+
+const ProxyConfig& proxyConfig()
+{
+    return *_current.load(std::memory_order_acquire);
+}
+
+void loadConfig()
+{
+    char path[1024];
+    std::lock_guard lock(_lock);
+
+    // Next to the proxy, the game's working directory is often somewhere else
+    if (modulePath((const void*)&loadConfig, path, sizeof(path)))
+        _path = (std::filesystem::path(path).parent_path() / ConfigFileName).string();
+    else
+        _path = ConfigFileName;
+
+    publish(buildConfig());
+}
+
+void publishConfig(ProxyConfig config)
+{
+    std::lock_guard lock(_lock);
+    publish(std::make_unique<ProxyConfig>(std::move(config)));
+}
+
+static void logSnapshot(const ProxyConfig& config, const char* action)
+{
+    if (config.path.empty())
+    {
+        log(LogLevel::Info, LogCategoryGeneral, std::string("config: no ") + _path + ", using the defaults");
+        return;
+    }
+
+    log(LogLevel::Info, LogCategoryGeneral, std::string("config: ") + action + " " + config.path + ", snapshot " + std::to_string(config.generation));
+
+    size_t begin = 0;
+
+    for (auto end = config.problems.find('\n'); end != std::string::npos; begin = end + 1, end = config.problems.find('\n', begin))
+        log(LogLevel::Warning, LogCategoryGeneral, "config: " + config.problems.substr(begin, end - begin));
+}
+
+void logConfig()
+{
+    std::lock_guard lock(_lock);
+    logSnapshot(proxyConfig(), "read");
+}
+
+static bool writeTime(std::filesystem::file_time_type& time)
+{
+    std::error_code error;
+    time = std::filesystem::last_write_time(_path, error);
+    return !error;
+}
+
+// Checks the write time only, a reload reads the whole file. Sleeps in short steps so
+// stopping doesn't wait out a whole interval.
+static void watcherThread()
+{
+    std::filesystem::file_time_type lastTime;
+    auto existed = writeTime(lastTime);
+    uint32_t waited = 0;
+
+    while (_watcherRunning.load(std::memory_order_acquire))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        waited += 10;
+
+        if (waited < ConfigWatchInterval)
+            continue;
+
+        waited = 0;
+
+        std::filesystem::file_time_type time;
+        auto exists = writeTime(time);
+
+        if (exists == existed && (!exists || time == lastTime))
+            continue;
+
+        existed = exists;
+        lastTime = time;
+
+        std::string provider;
+        {
+            std::lock_guard lock(_lock);
+
+            auto& previous = proxyConfig();
+            auto published = publish(buildConfig());
+            logSnapshot(*published, "reloaded");
+
+            if (published->logFile != previous.logFile || published->traceFile != previous.traceFile)
+                log(LogLevel::Info, LogCategoryGeneral, "config: log and trace file names take effect on the next start");
+
+            if (published->providerFile != previous.providerFile)
+                provider = published->providerFile;
+        }
+
+        // Loads the library, outside of the lock
+        if (!provider.empty())
+            requestProviderSwap(provider.c_str());
+    }
+
+}
+
+void startConfigWatcher()
+{
+    if (_watcherRunning.exchange(true))
+        return;
+
+    _watcher = std::thread(watcherThread);
+}
+
+void stopConfigWatcher()
+{
+    if (!_watcherRunning.exchange(false))
+        return;
+
+    // It may be loading a provider, the join waits for that instead of unloading under it
+    if (_watcher.joinable())
+        _watcher.join();
+}
+
+void abandonConfigWatcher()
+{
+    if (!_watcherRunning.exchange(false))
+        return;
+
+    // The thread is gone, only its handle is left
+    if (_watcher.joinable())
+        _watcher.detach();
+}
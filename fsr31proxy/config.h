@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "capture.h"
+#include "log.h"
+#include "platform.h"
+#include "query_cache.h"
+
+// Read from the proxy's own directory, a missing file leaves everything at the defaults
+constexpr const char* ConfigFileName = "fsr31proxy.ini";
+
+// Milliseconds between checks of the file's write time
+constexpr uint32_t ConfigWatchInterval = 1000;
+
+// Everything the proxy can be told. A snapshot is never changed once published, a new one
+// replaces it. The file names only take effect at startup.
+struct ProxyConfig
+{
+    // [log]
+    std::string logFile = "fsr31proxy.log";
+    std::string traceFile = "fsr31proxy.trace";     // empty writes no trace
+    LogLevel logLevel = LogCompiledLevel;
+    uint32_t logCategories = LogCategoryAll;
+
+    // [capture]
+    bool capture = true;            // off keeps log messages but records no calls
+    CaptureSampling sampling = CaptureSampling::All;
+    uint32_t sampleInterval = 1;
+    uint32_t keyframeInterval = CaptureKeyframeInterval;   // text log only, the trace is always full
+
+    // [cache]
+    QueryCacheMode queryCache = QueryCacheMode::On;
+    bool versionCache = true;
+
+    // [provider], swapped in when it changes while the proxy runs
+    std::string providerFile = DefaultProviderName;
+
+    uint64_t generation = 0;        // 0 for the defaults, counts up with every distinct snapshot
+    std::string path;               // file it was read from, empty when there was none
+    std::string problems;           // lines that couldn't be used, one per line
+};
+
+// The current snapshot, a single acquire load. Snapshots are kept until the proxy unloads,
+// the reference stays valid. One per distinct set of settings, publishing the same settings
+// again republishes the earlier snapshot.
+const ProxyConfig& proxyConfig();
+
+// Reads the file, puts the FSR31PROXY_PROVIDER, FSR31PROXY_QUERY_CACHE and
+// FSR31PROXY_VERSION_CACHE environment variables on top and publishes the result. The log
+// level and categories are applied right away.
+void loadConfig();
+
+// Publishes a changed copy of the current snapshot, the next reload of the file replaces it
+void publishConfig(ProxyConfig config);
+
+// Logs where the snapshot came from and its problems, once logging is set up
+void logConfig();
+
+// Checks the file every ConfigWatchInterval and publishes a new snapshot when it changed.
+// Stopping joins the thread, not from DllMain or while holding the loader lock.
+void startConfigWatcher();
+void stopConfigWatcher();
+
+// For process exit, where the thread is already gone on Windows
+void abandonConfigWatcher();
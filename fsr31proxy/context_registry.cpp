@@ -0,0 +1,247 @@
+#include "pch.h"
+#include "context_registry.h"
+#include "descriptor_chain.h"
+#include "descriptors.h"
+#include "timer.h"
+#include "ffx_upscale.h"
+#include "ffx_framegeneration.h"
+
+// The backend headers need the Windows and Vulkan SDKs, only their type ids are used here
+constexpr uint64_t BackendTypeDX12 = 0x0000002u;   // FFX_API_CREATE_CONTEXT_DESC_TYPE_BACKEND_DX12
+constexpr uint64_t BackendTypeVK = 0x0000003u;     // FFX_API_CREATE_CONTEXT_DESC_TYPE_BACKEND_VK
+
+enum class SlotState : uint32_t
+{
+    Empty,          // never used, ends a lookup
+    Claimed,        // being filled by registerContext
+    Live,
+    Destroying,     // in the provider's destroy, skipped by lookups but not reused yet
+    Removed,        // destroyed, skipped by lookups and reused by inserts
+};
+
+// Open addressing with linear probing. Slots are claimed with a CAS on the state and
+// published with a release store, lookups only read, so they never wait on a writer.
+// Lookups stop at an empty slot or after the furthest any insert had to probe, once every
+// slot has been used there are no empty ones left to stop at.
+struct ContextSlot
+{
+    std::atomic<SlotState> state{ SlotState::Empty };
+    std::atomic<uint64_t> context{ 0 };
+    ContextInfo info;
+};
+
+static ContextSlot _slots[ContextRegistryCapacity];
+static std::atomic<uint64_t> _created{ 0 };
+static std::atomic<uint64_t> _destroyed{ 0 };
+static std::atomic<uint64_t> _overflowed{ 0 };
+static std::atomic<uint64_t> _unknownDestroys{ 0 };
+static std::atomic<uint32_t> _probeLimit{ 0 };
+
+static uint32_t contextHash(uint64_t context)
+{
+    // Handles are heap pointers, the low bits carry no information
+    return (uint32_t)(((context >> 4) * 0x9e3779b97f4a7c15ull) >> 32) & (ContextRegistryCapacity - 1);
+}
+
+static void describeContext(ContextInfo& info, uint64_t context, const ffxApiHeader* desc, uint64_t timestamp, ProviderTable* provider)
+{
+    info.createType = desc != nullptr ? desc->type : 0;
+    info.backendType = 0;
+    info.effect = (uint32_t)(info.createType & FFX_API_EFFECT_MASK);
+    info.flags = 0;
+    info.maxRenderSize = {};
+    info.maxOutputSize = {};
+    info.created = timestamp;
+    info.provider = provider;
+    info.configures.store(0, std::memory_order_relaxed);
+    info.queries.store(0, std::memory_order_relaxed);
+    info.dispatches.store(0, std::memory_order_relaxed);
+    info.failures.store(0, std::memory_order_relaxed);
+    info.lastCall.store(timestamp, std::memory_order_relaxed);
+    resetFrameIds(info.frameIds, context);
+
+    walkDescriptorChain(desc, [&](const ffxApiHeader* header)
+    {
+        switch (header->type)
+        {
+            case FFX_API_CREATE_CONTEXT_DESC_TYPE_UPSCALE:
+            {
+                auto upscale = (const ffxCreateContextDescUpscale*)header;
+                info.flags = upscale->flags;
+                info.maxRenderSize = upscale->maxRenderSize;
+                info.maxOutputSize = upscale->maxUpscaleSize;
+                break;
+            }
+
+            case FFX_API_CREATE_CONTEXT_DESC_TYPE_FRAMEGENERATION:
+            {
+                auto frameGeneration = (const ffxCreateContextDescFrameGeneration*)header;
+                info.flags = frameGeneration->flags;
+                info.maxRenderSize = frameGeneration->maxRenderSize;
+                info.maxOutputSize = frameGeneration->displaySize;
+                break;
+            }
+
+            case BackendTypeDX12:
+            case BackendTypeVK:
+                info.backendType = header->type;
+                break;
+        }
+
+        return true;
+    });
+}
+
+ContextInfo* registerContext(ffxContext context, const ffxApiHeader* desc, uint64_t timestamp, ProviderTable* provider)
+{
+    auto key = (uint64_t)(uintptr_t)context;
+    auto start = contextHash(key);
+
+    for (uint32_t i = 0; i < ContextRegistryCapacity; i++)
+    {
+        auto& slot = _slots[(start + i) & (ContextRegistryCapacity - 1)];
+        auto state = slot.state.load(std::memory_order_relaxed);
+
+        if (state != SlotState::Empty && state != SlotState::Removed)
+            continue;
+
+        if (!slot.state.compare_exchange_strong(state, SlotState::Claimed, std::memory_order_acquire))
+            continue;
+
+        // Raised before the slot is published, a lookup that can see the context sees the limit
+        auto limit = _probeLimit.load(std::memory_order_relaxed);
+        while (limit < i + 1 && !_probeLimit.compare_exchange_weak(limit, i + 1, std::memory_order_relaxed))
+            ;
+
+        slot.context.store(key, std::memory_order_relaxed);
+        describeContext(slot.info, key, desc, timestamp, provider);
+        slot.state.store(SlotState::Live, std::memory_order_release);
+
+        _created.fetch_add(1, std::memory_order_relaxed);
+        return &slot.info;
+    }
+
+    _overflowed.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+static ContextSlot* findSlot(uint64_t key)
+{
+    auto start = contextHash(key);
+    auto limit = _probeLimit.load(std::memory_order_relaxed);
+
+    for (uint32_t i = 0; i < limit; i++)
+    {
+        auto& slot = _slots[(start + i) & (ContextRegistryCapacity - 1)];
+        auto state = slot.state.load(std::memory_order_acquire);
+
+        if (state == SlotState::Empty)
+            return nullptr;
+
+        if (state == SlotState::Live && slot.context.load(std::memory_order_relaxed) == key)
+            return &slot;
+    }
+
+    return nullptr;
+}
+
+static ContextSlot& slotOf(ContextInfo* info)
+{
+    return _slots[(size_t)((const char*)info - (const char*)&_slots[0].info) / sizeof(ContextSlot)];
+}
+
+void retireContext(ContextInfo* info)
+{
+    if (info != nullptr)
+        slotOf(info).state.store(SlotState::Destroying, std::memory_order_release);
+}
+
+void unregisterContext(ContextInfo* info, bool destroyed)
+{
+    if (info == nullptr)
+    {
+        if (destroyed)
+            _unknownDestroys.fetch_add(1, std::memory_order_relaxed);
+
+        return;
+    }
+
+    slotOf(info).state.store(destroyed ? SlotState::Removed : SlotState::Live, std::memory_order_release);
+
+    if (destroyed)
+        _destroyed.fetch_add(1, std::memory_order_relaxed);
+}
+
+ContextInfo* findContext(ffxContext context)
+{
+    auto slot = findSlot((uint64_t)(uintptr_t)context);
+    return slot != nullptr ? &slot->info : nullptr;
+}
+
+void countContextCall(ContextInfo* info, CaptureEntry entry, ffxReturnCode_t result, uint64_t timestamp)
+{
+    switch (entry)
+    {
+        case CaptureEntry::Configure: info->configures.fetch_add(1, std::memory_order_relaxed); break;
+        case CaptureEntry::Query: info->queries.fetch_add(1, std::memory_order_relaxed); break;
+        case CaptureEntry::Dispatch: info->dispatches.fetch_add(1, std::memory_order_relaxed); break;
+        default: break;
+    }
+
+    if (result != FFX_API_RETURN_OK)
+        info->failures.fetch_add(1, std::memory_order_relaxed);
+
+    info->lastCall.store(timestamp, std::memory_order_relaxed);
+}
+
+ContextRegistryStats contextRegistryStats()
+{
+    ContextRegistryStats stats = {};
+    stats.created = _created.load(std::memory_order_relaxed);
+    stats.destroyed = _destroyed.load(std::memory_order_relaxed);
+    stats.overflowed = _overflowed.load(std::memory_order_relaxed);
+    stats.unknownDestroys = _unknownDestroys.load(std::memory_order_relaxed);
+    stats.live = stats.created - stats.destroyed;
+    stats.probeLimit = _probeLimit.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void reportContexts(FormatBuffer& out, std::string_view time)
+{
+    auto stats = contextRegistryStats();
+
+    out.append('[').append(time).append("] contexts: ").appendNumber(stats.created).append(" created, ").appendNumber(stats.destroyed);
+    out.append(" destroyed, ").appendNumber(stats.live).append(" not destroyed");
+
+    if (stats.overflowed > 0)
+        out.append(", ").appendNumber(stats.overflowed).append(" not tracked");
+
+    if (stats.unknownDestroys > 0)
+        out.append(", ").appendNumber(stats.unknownDestroys).append(" unknown destroyed");
+
+    out.append('\n');
+
+    for (auto& slot : _slots)
+    {
+        if (slot.state.load(std::memory_order_acquire) != SlotState::Live)
+            continue;
+
+        auto& info = slot.info;
+        auto typeName = descriptorName(info.createType);
+        char created[32];
+        auto createdLength = timerFormat(info.created, created, sizeof(created));
+
+        out.append('[').append(time).append("] context ").appendNumber(slot.context.load(std::memory_order_relaxed)).append(" not destroyed: ");
+
+        if (typeName != nullptr)
+            out.append(typeName);
+        else
+            out.appendNumber(info.createType);
+
+        out.append(" created ").append(std::string_view(created, createdLength));
+        out.append(", ").appendNumber(info.configures.load(std::memory_order_relaxed)).append(" configure, ");
+        out.appendNumber(info.queries.load(std::memory_order_relaxed)).append(" query, ");
+        out.appendNumber(info.dispatches.load(std::memory_order_relaxed)).append(" dispatch, ");
+        out.appendNumber(info.failures.load(std::memory_order_relaxed)).append(" failed\n");
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include "ffx_api.h"
+#include "ffx_api_types.h"
+#include "format_buffer.h"
+#include "frame_ids.h"
+#include "trace_format.h"
+
+struct ProviderTable;
+
+constexpr uint32_t ContextRegistryCapacity = 1024;
+
+// What the proxy knows about a live context. The create time fields are written once before
+// the context is published and only the counters change afterwards.
+struct ContextInfo
+{
+    uint64_t createType;            // first descriptor of the create chain
+    uint64_t backendType;           // backend descriptor chained to it, 0 if none
+    uint32_t effect;                // FFX_API_EFFECT_ID_* of createType
+    uint32_t flags;                 // create flags of upscale and frame generation contexts
+    FfxApiDimensions2D maxRenderSize;
+    FfxApiDimensions2D maxOutputSize;   // maxUpscaleSize or displaySize
+    uint64_t created;               // timestamp of the ffxCreateContext call
+    ProviderTable* provider;        // table it was created through, its calls and destroy go there
+
+    std::atomic<uint64_t> configures;
+    std::atomic<uint64_t> queries;
+    std::atomic<uint64_t> dispatches;
+    std::atomic<uint64_t> failures;
+    std::atomic<uint64_t> lastCall;
+
+    FrameIdState frameIds;
+};
+
+struct ContextRegistryStats
+{
+    uint64_t created;
+    uint64_t destroyed;
+    uint64_t live;
+    uint64_t overflowed;            // created while the registry was full, never tracked
+    uint64_t unknownDestroys;       // destroyed but never seen created
+    uint32_t probeLimit;            // furthest a context was placed from its hash slot, in slots
+};
+
+// Called after a successful ffxCreateContext, returns null when the registry is full
+ContextInfo* registerContext(ffxContext context, const ffxApiHeader* desc, uint64_t timestamp, ProviderTable* provider);
+
+// Around the provider's ffxDestroyContext, with what findContext returned before it. The
+// provider frees the handle before it returns and a create on another thread may get the
+// same one, so the context stops being found first. Unregistering removes it when it was
+// destroyed and makes it findable again when the destroy failed. A null info counts an
+// unknown destroy.
+void retireContext(ContextInfo* info);
+void unregisterContext(ContextInfo* info, bool destroyed);
+
+// Wait-free, probes no further than the furthest any context was placed from its hash slot,
+// so a miss stays cheap after every slot was used once. The result is valid until the
+// context is destroyed.
+ContextInfo* findContext(ffxContext context);
+
+void countContextCall(ContextInfo* info, CaptureEntry entry, ffxReturnCode_t result, uint64_t timestamp);
+
+ContextRegistryStats contextRegistryStats();
+
+// Appends the totals and one line per context that is still alive, i.e. leaked at shutdown
+void reportContexts(FormatBuffer& out, std::string_view time);
@@ -0,0 +1,98 @@
+#include "pch.h"
+#include "control.h"
+#include "call_latency.h"
+#include "capture.h"
+#include "config.h"
+#include "frame_stats.h"
+#include "log.h"
+
+#if __has_include(<d3d12.h>)
+#include "dx12/ffx_api_dx12.h"
+static_assert(ControlSwapChainKeyValueDX12 == FFX_API_CONFIGURE_DESC_TYPE_FRAMEGENERATIONSWAPCHAIN_KEYVALUE_DX12);
+#endif
+
+#if __has_include(<vulkan/vulkan.h>)
+#include "vk/ffx_api_vk.h"
+static_assert(ControlSwapChainKeyValueVK == FFX_API_CONFIGURE_DESC_TYPE_FRAMEGENERATIONSWAPCHAIN_KEYVALUE_VK);
+#endif
+
+// Sampling and capture go through a new config snapshot, the same way a reload does
+static void changeCapture(bool capture)
+{
+    auto config = proxyConfig();
+    config.capture = capture;
+    publishConfig(std::move(config));
+
+    log(LogLevel::Info, LogCategoryGeneral, capture ? "control: recording calls" : "control: not recording calls");
+}
+
+// Same names as in the config file
+static const char* samplingName(CaptureSampling sampling)
+{
+    switch (sampling)
+    {
+        case CaptureSampling::All: return "all";
+        case CaptureSampling::EveryNth: return "every";
+        case CaptureSampling::ResetOnly: return "reset";
+        default: return "unknown";
+    }
+}
+
+static void changeSampling(CaptureSampling sampling, uint32_t interval)
+{
+    auto config = proxyConfig();
+    config.sampling = sampling;
+    config.sampleInterval = interval;
+    publishConfig(std::move(config));
+
+    log(LogLevel::Info, LogCategoryGeneral, std::string("control: sampling ") + samplingName(sampling) + ", interval " + std::to_string(interval));
+}
+
+ffxReturnCode_t handleControlKey(const ffxConfigureDescHeader* desc)
+{
+    // Nothing of a chain is applied, the provider's links would otherwise be dropped silently
+    if (desc->pNext != nullptr)
+    {
+        log(LogLevel::Error, LogCategoryGeneral, "control: proxy key chained with other descriptors, nothing applied");
+        return FFX_API_RETURN_ERROR_PARAMETER;
+    }
+
+    auto keyValue = (const ffxConfigureDescUpscaleKeyValue*)desc;
+    auto value = keyValue->u64;
+
+    switch (keyValue->key)
+    {
+        case FSR31PROXY_KEY_CAPTURE:
+            if (value > 1)
+                return FFX_API_RETURN_ERROR_PARAMETER;
+
+            changeCapture(value != 0);
+            return FFX_API_RETURN_OK;
+
+        case FSR31PROXY_KEY_FLUSH:
+            return flushCapture() ? FFX_API_RETURN_OK : FFX_API_RETURN_ERROR;
+
+        case FSR31PROXY_KEY_RESET_STATISTICS:
+            resetCallLatency();
+            resetFrameStats();
+            log(LogLevel::Info, LogCategoryGeneral, "control: statistics reset");
+            return FFX_API_RETURN_OK;
+
+        case FSR31PROXY_KEY_SAMPLING:
+            if (value > (uint64_t)CaptureSampling::ResetOnly)
+                return FFX_API_RETURN_ERROR_PARAMETER;
+
+            changeSampling((CaptureSampling)value, proxyConfig().sampleInterval);
+            return FFX_API_RETURN_OK;
+
+        case FSR31PROXY_KEY_SAMPLE_INTERVAL:
+            if (value == 0 || value > UINT32_MAX)
+                return FFX_API_RETURN_ERROR_PARAMETER;
+
+            changeSampling(proxyConfig().sampling, (uint32_t)value);
+            return FFX_API_RETURN_OK;
+
+        default:
+            return FFX_API_RETURN_ERROR_PARAMETER;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include "fsr31proxy.h"
+#include "ffx_upscale.h"
+#include "ffx_framegeneration.h"
+
+// The swap chain key-value types, their headers need the DX12 and Vulkan SDKs
+constexpr uint64_t ControlSwapChainKeyValueDX12 = 0x30008u;
+constexpr uint64_t ControlSwapChainKeyValueVK = 0x40008u;
+
+// True for a key-value descriptor with a proxy key at the head of a configure chain. Every
+// other configure pays a few compares of the type, the key is only read for key-value types.
+inline bool isControlKey(const ffxConfigureDescHeader* desc)
+{
+    if (desc == nullptr)
+        return false;
+
+    switch (desc->type)
+    {
+        // All four have the same layout
+        case FFX_API_CONFIGURE_DESC_TYPE_UPSCALE_KEYVALUE:
+        case FFX_API_CONFIGURE_DESC_TYPE_FRAMEGENERATION_KEYVALUE:
+        case ControlSwapChainKeyValueDX12:
+        case ControlSwapChainKeyValueVK:
+            return (((const ffxConfigureDescUpscaleKeyValue*)desc)->key & FSR31PROXY_KEY_MASK) == FSR31PROXY_KEY_BASE;
+
+        default:
+            return false;
+    }
+}
+
+// Acts on a descriptor isControlKey accepted. A proxy key can't be chained, a chain returns
+// FFX_API_RETURN_ERROR_PARAMETER without acting on any of it.
+ffxReturnCode_t handleControlKey(const ffxConfigureDescHeader* desc);
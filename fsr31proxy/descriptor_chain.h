@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include "ffx_api.h"
+
+// Longest pNext chain that is followed, real chains are a handful of descriptors
+constexpr uint32_t MaxDescriptorChainLength = 16;
+
+enum class ChainEnd : uint8_t
+{
+    Complete,
+    Stopped,        // visit returned false
+    Cycle,          // pNext pointed back at a descriptor already visited
+    TooLong,
+};
+
+// Calls visit(const ffxApiHeader*) for every descriptor of the chain until it returns false.
+// Visited headers are kept on the stack, so walking never allocates and always ends.
+template <typename F>
+ChainEnd walkDescriptorChain(const ffxApiHeader* desc, F&& visit)
+{
+    const ffxApiHeader* visited[MaxDescriptorChainLength];
+    uint32_t count = 0;
+
+    for (auto header = desc; header != nullptr; header = header->pNext)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (visited[i] == header)
+                return ChainEnd::Cycle;
+        }
+
+        if (count == MaxDescriptorChainLength)
+            return ChainEnd::TooLong;
+
+        visited[count++] = header;
+
+        if (!visit(header))
+            return ChainEnd::Stopped;
+    }
+
+    return ChainEnd::Complete;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include "ffx_api_types.h"
+
+// Value kinds a descriptor field can have, each one is a fixed size in memory
+enum class FieldKind : uint8_t
+{
+    Bool,
+    Int32,
+    UInt32,
+    UInt64,
+    Float,
+    Pointer,        // pointers and dispatchable handles, written as their address
+    Callback,       // function pointers, written as their address
+    Resource,       // FfxApiResource, identified by its resource pointer
+    Dimensions2D,
+    FloatCoords2D,
+    Rect2D,
+};
+
+struct FieldInfo
+{
+    const char* name;
+    uint32_t offset;
+    FieldKind kind;
+    uint32_t count;     // elements for fixed size arrays, 1 otherwise
+};
+
+constexpr size_t fieldKindSize(FieldKind kind)
+{
+    switch (kind)
+    {
+        case FieldKind::Bool: return sizeof(bool);
+        case FieldKind::Int32: return sizeof(int32_t);
+        case FieldKind::UInt32: return sizeof(uint32_t);
+        case FieldKind::UInt64: return sizeof(uint64_t);
+        case FieldKind::Float: return sizeof(float);
+        case FieldKind::Pointer: return sizeof(void*);
+        case FieldKind::Callback: return sizeof(void*);
+        case FieldKind::Resource: return sizeof(FfxApiResource);
+        case FieldKind::Dimensions2D: return sizeof(FfxApiDimensions2D);
+        case FieldKind::FloatCoords2D: return sizeof(FfxApiFloatCoords2D);
+        case FieldKind::Rect2D: return sizeof(FfxApiRect2D);
+        default: return 0;
+    }
+}
+
+template <typename T>
+struct FieldKindOf
+{
+    static_assert(!std::is_same_v<T, T>, "No FieldKind for this member type");
+};
+
+template <> struct FieldKindOf<bool> { static constexpr FieldKind value = FieldKind::Bool; };
+template <> struct FieldKindOf<int32_t> { static constexpr FieldKind value = FieldKind::Int32; };
+template <> struct FieldKindOf<uint32_t> { static constexpr FieldKind value = FieldKind::UInt32; };
+template <> struct FieldKindOf<uint64_t> { static constexpr FieldKind value = FieldKind::UInt64; };
+template <> struct FieldKindOf<float> { static constexpr FieldKind value = FieldKind::Float; };
+template <> struct FieldKindOf<FfxApiResource> { static constexpr FieldKind value = FieldKind::Resource; };
+template <> struct FieldKindOf<FfxApiDimensions2D> { static constexpr FieldKind value = FieldKind::Dimensions2D; };
+template <> struct FieldKindOf<FfxApiFloatCoords2D> { static constexpr FieldKind value = FieldKind::FloatCoords2D; };
+template <> struct FieldKindOf<FfxApiRect2D> { static constexpr FieldKind value = FieldKind::Rect2D; };
+
+template <typename T>
+constexpr FieldKind fieldKind()
+{
+    if constexpr (std::is_array_v<T>)
+        return fieldKind<std::remove_extent_t<T>>();
+    else if constexpr (std::is_pointer_v<T> && std::is_function_v<std::remove_pointer_t<T>>)
+        return FieldKind::Callback;
+    else if constexpr (std::is_pointer_v<T>)
+        return FieldKind::Pointer;
+    else if constexpr (std::is_enum_v<T>)
+        return std::is_signed_v<std::underlying_type_t<T>> ? FieldKind::Int32 : FieldKind::UInt32;
+    else
+        return FieldKindOf<T>::value;
+}
+
+template <typename T>
+constexpr FieldInfo fieldInfo(const char* name, size_t offset)
+{
+    static_assert(!std::is_array_v<T> || std::rank_v<T> == 1, "Only one dimensional arrays are supported");
+    static_assert(sizeof(std::remove_extent_t<T>) == fieldKindSize(fieldKind<T>()), "Member size doesn't match its FieldKind");
+
+    return { name, (uint32_t)offset, fieldKind<T>(), std::is_array_v<T> ? (uint32_t)std::extent_v<T> : 1u };
+}
+
+// Members of a nested struct are flattened into the outer table as "outer.member"
+#define DESCRIPTOR_FIELD(Struct, member) fieldInfo<decltype(Struct::member)>(#member, offsetof(Struct, member))
+#define DESCRIPTOR_NESTED_FIELD(Struct, outer, member) \
+    fieldInfo<decltype(decltype(Struct::outer)::member)>(#outer "." #member, offsetof(Struct, outer) + offsetof(decltype(Struct::outer), member))
+
+// Field table of a descriptor struct, the header is left out. Structs without a
+// specialization only have their type written.
+template <typename T>
+struct DescriptorFields
+{
+    static constexpr std::span<const FieldInfo> fields = {};
+};
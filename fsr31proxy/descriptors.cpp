@@ -0,0 +1,717 @@
+#include "pch.h"
+#include "descriptors.h"
+#include "descriptor_fields.h"
+#include "ffx_upscale.hpp"
+#include "ffx_framegeneration.hpp"
+#include <cstring>
+#include <iterator>
+
+// The DX12 descriptors need the Windows SDK headers, POSIX builds leave them out
+#if __has_include(<d3d12.h>)
+#include "dx12/ffx_api_dx12.hpp"
+#define FSR31PROXY_DX12_DESCRIPTORS
+#endif
+
+// The Vulkan descriptors can only be described where the Vulkan SDK headers are available
+#if __has_include(<vulkan/vulkan.h>)
+#include "vk/ffx_api_vk.hpp"
+#define FSR31PROXY_VULKAN_DESCRIPTORS
+#endif
+
+// The present callback descriptor has no trait in the ffx headers
+template <>
+struct ffx::struct_type<ffxCallbackDescFrameGenerationPresent> : std::integral_constant<uint64_t, FFX_API_CALLBACK_DESC_TYPE_FRAMEGENERATION_PRESENT> {};
+
+template <>
+struct DescriptorFields<ffxConfigureDescGlobalDebug1>
+{
+    using T = ffxConfigureDescGlobalDebug1;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, fpMessage),
+        DESCRIPTOR_FIELD(T, debugLevel),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxQueryDescGetVersions>
+{
+    using T = ffxQueryDescGetVersions;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, createDescType),
+        DESCRIPTOR_FIELD(T, device),
+        DESCRIPTOR_FIELD(T, outputCount),
+        DESCRIPTOR_FIELD(T, versionIds),
+        DESCRIPTOR_FIELD(T, versionNames),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxOverrideVersion>
+{
+    using T = ffxOverrideVersion;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, versionId),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxCreateContextDescUpscale>
+{
+    using T = ffxCreateContextDescUpscale;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, flags),
+        DESCRIPTOR_FIELD(T, maxRenderSize),
+        DESCRIPTOR_FIELD(T, maxUpscaleSize),
+        DESCRIPTOR_FIELD(T, fpMessage),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxDispatchDescUpscale>
+{
+    using T = ffxDispatchDescUpscale;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, commandList),
+        DESCRIPTOR_FIELD(T, color),
+        DESCRIPTOR_FIELD(T, depth),
+        DESCRIPTOR_FIELD(T, motionVectors),
+        DESCRIPTOR_FIELD(T, exposure),
+        DESCRIPTOR_FIELD(T, reactive),
+        DESCRIPTOR_FIELD(T, transparencyAndComposition),
+        DESCRIPTOR_FIELD(T, output),
+        DESCRIPTOR_FIELD(T, jitterOffset),
+        DESCRIPTOR_FIELD(T, motionVectorScale),
+        DESCRIPTOR_FIELD(T, renderSize),
+        DESCRIPTOR_FIELD(T, upscaleSize),
+        DESCRIPTOR_FIELD(T, enableSharpening),
+        DESCRIPTOR_FIELD(T, sharpness),
+        DESCRIPTOR_FIELD(T, frameTimeDelta),
+        DESCRIPTOR_FIELD(T, preExposure),
+        DESCRIPTOR_FIELD(T, reset),
+        DESCRIPTOR_FIELD(T, cameraNear),
+        DESCRIPTOR_FIELD(T, cameraFar),
+        DESCRIPTOR_FIELD(T, cameraFovAngleVertical),
+        DESCRIPTOR_FIELD(T, viewSpaceToMetersFactor),
+        DESCRIPTOR_FIELD(T, flags),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxQueryDescUpscaleGetUpscaleRatioFromQualityMode>
+{
+    using T = ffxQueryDescUpscaleGetUpscaleRatioFromQualityMode;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, qualityMode),
+        DESCRIPTOR_FIELD(T, pOutUpscaleRatio),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxQueryDescUpscaleGetRenderResolutionFromQualityMode>
+{
+    using T = ffxQueryDescUpscaleGetRenderResolutionFromQualityMode;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, displayWidth),
+        DESCRIPTOR_FIELD(T, displayHeight),
+        DESCRIPTOR_FIELD(T, qualityMode),
+        DESCRIPTOR_FIELD(T, pOutRenderWidth),
+        DESCRIPTOR_FIELD(T, pOutRenderHeight),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxQueryDescUpscaleGetJitterPhaseCount>
+{
+    using T = ffxQueryDescUpscaleGetJitterPhaseCount;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, renderWidth),
+        DESCRIPTOR_FIELD(T, displayWidth),
+        DESCRIPTOR_FIELD(T, pOutPhaseCount),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxQueryDescUpscaleGetJitterOffset>
+{
+    using T = ffxQueryDescUpscaleGetJitterOffset;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, index),
+        DESCRIPTOR_FIELD(T, phaseCount),
+        DESCRIPTOR_FIELD(T, pOutX),
+        DESCRIPTOR_FIELD(T, pOutY),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxDispatchDescUpscaleGenerateReactiveMask>
+{
+    using T = ffxDispatchDescUpscaleGenerateReactiveMask;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, commandList),
+        DESCRIPTOR_FIELD(T, colorOpaqueOnly),
+        DESCRIPTOR_FIELD(T, colorPreUpscale),
+        DESCRIPTOR_FIELD(T, outReactive),
+        DESCRIPTOR_FIELD(T, renderSize),
+        DESCRIPTOR_FIELD(T, scale),
+        DESCRIPTOR_FIELD(T, cutoffThreshold),
+        DESCRIPTOR_FIELD(T, binaryValue),
+        DESCRIPTOR_FIELD(T, flags),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxConfigureDescUpscaleKeyValue>
+{
+    using T = ffxConfigureDescUpscaleKeyValue;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, key),
+        DESCRIPTOR_FIELD(T, u64),
+        DESCRIPTOR_FIELD(T, ptr),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxCreateContextDescFrameGeneration>
+{
+    using T = ffxCreateContextDescFrameGeneration;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, flags),
+        DESCRIPTOR_FIELD(T, displaySize),
+        DESCRIPTOR_FIELD(T, maxRenderSize),
+        DESCRIPTOR_FIELD(T, backBufferFormat),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxCallbackDescFrameGenerationPresent>
+{
+    using T = ffxCallbackDescFrameGenerationPresent;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, device),
+        DESCRIPTOR_FIELD(T, commandList),
+        DESCRIPTOR_FIELD(T, currentBackBuffer),
+        DESCRIPTOR_FIELD(T, currentUI),
+        DESCRIPTOR_FIELD(T, outputSwapChainBuffer),
+        DESCRIPTOR_FIELD(T, isGeneratedFrame),
+        DESCRIPTOR_FIELD(T, frameID),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxDispatchDescFrameGeneration>
+{
+    using T = ffxDispatchDescFrameGeneration;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, commandList),
+        DESCRIPTOR_FIELD(T, presentColor),
+        DESCRIPTOR_FIELD(T, outputs),
+        DESCRIPTOR_FIELD(T, numGeneratedFrames),
+        DESCRIPTOR_FIELD(T, reset),
+        DESCRIPTOR_FIELD(T, backbufferTransferFunction),
+        DESCRIPTOR_FIELD(T, minMaxLuminance),
+        DESCRIPTOR_FIELD(T, generationRect),
+        DESCRIPTOR_FIELD(T, frameID),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxConfigureDescFrameGeneration>
+{
+    using T = ffxConfigureDescFrameGeneration;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, swapChain),
+        DESCRIPTOR_FIELD(T, presentCallback),
+        DESCRIPTOR_FIELD(T, presentCallbackUserContext),
+        DESCRIPTOR_FIELD(T, frameGenerationCallback),
+        DESCRIPTOR_FIELD(T, frameGenerationCallbackUserContext),
+        DESCRIPTOR_FIELD(T, frameGenerationEnabled),
+        DESCRIPTOR_FIELD(T, allowAsyncWorkloads),
+        DESCRIPTOR_FIELD(T, HUDLessColor),
+        DESCRIPTOR_FIELD(T, flags),
+        DESCRIPTOR_FIELD(T, onlyPresentGenerated),
+        DESCRIPTOR_FIELD(T, generationRect),
+        DESCRIPTOR_FIELD(T, frameID),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxDispatchDescFrameGenerationPrepare>
+{
+    using T = ffxDispatchDescFrameGenerationPrepare;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, frameID),
+        DESCRIPTOR_FIELD(T, flags),
+        DESCRIPTOR_FIELD(T, commandList),
+        DESCRIPTOR_FIELD(T, renderSize),
+        DESCRIPTOR_FIELD(T, jitterOffset),
+        DESCRIPTOR_FIELD(T, motionVectorScale),
+        DESCRIPTOR_FIELD(T, frameTimeDelta),
+        DESCRIPTOR_FIELD(T, unused_reset),
+        DESCRIPTOR_FIELD(T, cameraNear),
+        DESCRIPTOR_FIELD(T, cameraFar),
+        DESCRIPTOR_FIELD(T, cameraFovAngleVertical),
+        DESCRIPTOR_FIELD(T, viewSpaceToMetersFactor),
+        DESCRIPTOR_FIELD(T, depth),
+        DESCRIPTOR_FIELD(T, motionVectors),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxConfigureDescFrameGenerationKeyValue>
+{
+    using T = ffxConfigureDescFrameGenerationKeyValue;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, key),
+        DESCRIPTOR_FIELD(T, u64),
+        DESCRIPTOR_FIELD(T, ptr),
+    };
+};
+
+#ifdef FSR31PROXY_DX12_DESCRIPTORS
+
+template <>
+struct DescriptorFields<ffxCreateBackendDX12Desc>
+{
+    using T = ffxCreateBackendDX12Desc;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, device),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxCreateContextDescFrameGenerationSwapChainWrapDX12>
+{
+    using T = ffxCreateContextDescFrameGenerationSwapChainWrapDX12;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, swapchain),
+        DESCRIPTOR_FIELD(T, gameQueue),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxCreateContextDescFrameGenerationSwapChainNewDX12>
+{
+    using T = ffxCreateContextDescFrameGenerationSwapChainNewDX12;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, swapchain),
+        DESCRIPTOR_FIELD(T, desc),
+        DESCRIPTOR_FIELD(T, dxgiFactory),
+        DESCRIPTOR_FIELD(T, gameQueue),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxCreateContextDescFrameGenerationSwapChainForHwndDX12>
+{
+    using T = ffxCreateContextDescFrameGenerationSwapChainForHwndDX12;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, swapchain),
+        DESCRIPTOR_FIELD(T, hwnd),
+        DESCRIPTOR_FIELD(T, desc),
+        DESCRIPTOR_FIELD(T, fullscreenDesc),
+        DESCRIPTOR_FIELD(T, dxgiFactory),
+        DESCRIPTOR_FIELD(T, gameQueue),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxConfigureDescFrameGenerationSwapChainRegisterUiResourceDX12>
+{
+    using T = ffxConfigureDescFrameGenerationSwapChainRegisterUiResourceDX12;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, uiResource),
+        DESCRIPTOR_FIELD(T, flags),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxQueryDescFrameGenerationSwapChainInterpolationCommandListDX12>
+{
+    using T = ffxQueryDescFrameGenerationSwapChainInterpolationCommandListDX12;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, pOutCommandList),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxQueryDescFrameGenerationSwapChainInterpolationTextureDX12>
+{
+    using T = ffxQueryDescFrameGenerationSwapChainInterpolationTextureDX12;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, pOutTexture),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxConfigureDescFrameGenerationSwapChainKeyValueDX12>
+{
+    using T = ffxConfigureDescFrameGenerationSwapChainKeyValueDX12;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, key),
+        DESCRIPTOR_FIELD(T, u64),
+        DESCRIPTOR_FIELD(T, ptr),
+    };
+};
+
+#endif
+
+#ifdef FSR31PROXY_VULKAN_DESCRIPTORS
+
+// VkExtent2D has the same layout as FfxApiDimensions2D
+static_assert(sizeof(VkExtent2D) == sizeof(FfxApiDimensions2D));
+template <> struct FieldKindOf<VkExtent2D> { static constexpr FieldKind value = FieldKind::Dimensions2D; };
+
+template <>
+struct DescriptorFields<ffxCreateBackendVKDesc>
+{
+    using T = ffxCreateBackendVKDesc;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, vkDevice),
+        DESCRIPTOR_FIELD(T, vkPhysicalDevice),
+        DESCRIPTOR_FIELD(T, vkDeviceProcAddr),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxConfigureDescFrameGenerationSwapChainRegisterUiResourceVK>
+{
+    using T = ffxConfigureDescFrameGenerationSwapChainRegisterUiResourceVK;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, uiResource),
+        DESCRIPTOR_FIELD(T, flags),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxQueryDescFrameGenerationSwapChainInterpolationCommandListVK>
+{
+    using T = ffxQueryDescFrameGenerationSwapChainInterpolationCommandListVK;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, pOutCommandList),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxQueryDescFrameGenerationSwapChainInterpolationTextureVK>
+{
+    using T = ffxQueryDescFrameGenerationSwapChainInterpolationTextureVK;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, pOutTexture),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxConfigureDescFrameGenerationSwapChainKeyValueVK>
+{
+    using T = ffxConfigureDescFrameGenerationSwapChainKeyValueVK;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, key),
+        DESCRIPTOR_FIELD(T, u64),
+        DESCRIPTOR_FIELD(T, ptr),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxQueryDescSwapchainReplacementFunctionsVK>
+{
+    using T = ffxQueryDescSwapchainReplacementFunctionsVK;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, pOutCreateSwapchainFFXAPI),
+        DESCRIPTOR_FIELD(T, pOutDestroySwapchainFFXAPI),
+        DESCRIPTOR_FIELD(T, pOutGetSwapchainImagesKHR),
+        DESCRIPTOR_FIELD(T, pOutAcquireNextImageKHR),
+        DESCRIPTOR_FIELD(T, pOutQueuePresentKHR),
+        DESCRIPTOR_FIELD(T, pOutSetHdrMetadataEXT),
+        DESCRIPTOR_FIELD(T, pOutGetLastPresentCountFFXAPI),
+    };
+};
+
+template <>
+struct DescriptorFields<ffxCreateContextDescFrameGenerationSwapChainVK>
+{
+    using T = ffxCreateContextDescFrameGenerationSwapChainVK;
+    static constexpr FieldInfo fields[] =
+    {
+        DESCRIPTOR_FIELD(T, physicalDevice),
+        DESCRIPTOR_FIELD(T, device),
+        DESCRIPTOR_FIELD(T, swapchain),
+        DESCRIPTOR_FIELD(T, allocator),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, flags),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, surface),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, minImageCount),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, imageFormat),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, imageColorSpace),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, imageExtent),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, imageArrayLayers),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, imageUsage),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, imageSharingMode),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, preTransform),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, compositeAlpha),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, presentMode),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, clipped),
+        DESCRIPTOR_NESTED_FIELD(T, createInfo, oldSwapchain),
+        DESCRIPTOR_NESTED_FIELD(T, gameQueue, queue),
+        DESCRIPTOR_NESTED_FIELD(T, gameQueue, familyIndex),
+        DESCRIPTOR_NESTED_FIELD(T, asyncComputeQueue, queue),
+        DESCRIPTOR_NESTED_FIELD(T, asyncComputeQueue, familyIndex),
+        DESCRIPTOR_NESTED_FIELD(T, presentQueue, queue),
+        DESCRIPTOR_NESTED_FIELD(T, presentQueue, familyIndex),
+        DESCRIPTOR_NESTED_FIELD(T, imageAcquireQueue, queue),
+        DESCRIPTOR_NESTED_FIELD(T, imageAcquireQueue, familyIndex),
+    };
+};
+
+#endif
+
+// Content checks of a descriptor struct, specializations provide check(const T&)
+template <typename T>
+struct DescriptorValidator
+{
+};
+
+template <>
+struct DescriptorValidator<ffxCreateContextDescUpscale>
+{
+    static const char* check(const ffxCreateContextDescUpscale& desc)
+    {
+        if (desc.maxRenderSize.width == 0 || desc.maxRenderSize.height == 0)
+            return "maxRenderSize is empty";
+
+        if (desc.maxRenderSize.width > desc.maxUpscaleSize.width || desc.maxRenderSize.height > desc.maxUpscaleSize.height)
+            return "maxRenderSize is larger than maxUpscaleSize";
+
+        return nullptr;
+    }
+};
+
+template <>
+struct DescriptorValidator<ffxDispatchDescUpscale>
+{
+    static const char* check(const ffxDispatchDescUpscale& desc)
+    {
+        if (desc.renderSize.width == 0 || desc.renderSize.height == 0)
+            return "renderSize is empty";
+
+        // upscaleSize is optional, zero means maxUpscaleSize
+        if (desc.upscaleSize.width != 0 && (desc.renderSize.width > desc.upscaleSize.width || desc.renderSize.height > desc.upscaleSize.height))
+            return "renderSize is larger than upscaleSize";
+
+        if (!(desc.frameTimeDelta >= 0.0f))
+            return "frameTimeDelta is negative";
+
+        if (!(desc.preExposure > 0.0f))
+            return "preExposure is not positive";
+
+        if (desc.cameraNear == desc.cameraFar)
+            return "cameraNear equals cameraFar";
+
+        return nullptr;
+    }
+};
+
+template <>
+struct DescriptorValidator<ffxQueryDescUpscaleGetRenderResolutionFromQualityMode>
+{
+    static const char* check(const ffxQueryDescUpscaleGetRenderResolutionFromQualityMode& desc)
+    {
+        if (desc.displayWidth == 0 || desc.displayHeight == 0)
+            return "display size is empty";
+
+        return nullptr;
+    }
+};
+
+template <>
+struct DescriptorValidator<ffxCreateContextDescFrameGeneration>
+{
+    static const char* check(const ffxCreateContextDescFrameGeneration& desc)
+    {
+        if (desc.displaySize.width == 0 || desc.displaySize.height == 0)
+            return "displaySize is empty";
+
+        return nullptr;
+    }
+};
+
+template <>
+struct DescriptorValidator<ffxDispatchDescFrameGeneration>
+{
+    static const char* check(const ffxDispatchDescFrameGeneration& desc)
+    {
+        if (desc.numGeneratedFrames == 0 || desc.numGeneratedFrames > std::size(desc.outputs))
+            return "numGeneratedFrames is out of range";
+
+        return nullptr;
+    }
+};
+
+// Captured copies aren't aligned, validators get their own copy of the struct
+template <typename T>
+static const char* validateDescriptor(const uint8_t* data)
+{
+    T desc;
+    memcpy(&desc, data, sizeof(T));
+    return DescriptorValidator<T>::check(desc);
+}
+
+template <typename T>
+constexpr DescriptorValidateFn descriptorValidator()
+{
+    if constexpr (requires(const T& desc) { DescriptorValidator<T>::check(desc); })
+        return validateDescriptor<T>;
+    else
+        return nullptr;
+}
+
+// Type ids come from the ffx::struct_type traits, the macro only adds the name and checks it
+template <typename T, uint64_t Type>
+constexpr DescriptorInfo describe(const char* name)
+{
+    static_assert(ffx::struct_type<T>::value == Type, "Descriptor type doesn't match its struct");
+    return { ffx::struct_type<T>::value, sizeof(T), name, DescriptorFields<T>::fields, descriptorValidator<T>() };
+}
+
+#define DESCRIPTOR(TYPE, Struct) describe<Struct, TYPE>(#TYPE)
+
+static constexpr DescriptorInfo _descriptors[] =
+{
+    DESCRIPTOR(FFX_API_CONFIGURE_DESC_TYPE_GLOBALDEBUG1, ffxConfigureDescGlobalDebug1),
+    DESCRIPTOR(FFX_API_QUERY_DESC_TYPE_GET_VERSIONS, ffxQueryDescGetVersions),
+    DESCRIPTOR(FFX_API_DESC_TYPE_OVERRIDE_VERSION, ffxOverrideVersion),
+    DESCRIPTOR(FFX_API_CREATE_CONTEXT_DESC_TYPE_UPSCALE, ffxCreateContextDescUpscale),
+    DESCRIPTOR(FFX_API_DISPATCH_DESC_TYPE_UPSCALE, ffxDispatchDescUpscale),
+    DESCRIPTOR(FFX_API_QUERY_DESC_TYPE_UPSCALE_GETUPSCALERATIOFROMQUALITYMODE, ffxQueryDescUpscaleGetUpscaleRatioFromQualityMode),
+    DESCRIPTOR(FFX_API_QUERY_DESC_TYPE_UPSCALE_GETRENDERRESOLUTIONFROMQUALITYMODE, ffxQueryDescUpscaleGetRenderResolutionFromQualityMode),
+    DESCRIPTOR(FFX_API_QUERY_DESC_TYPE_UPSCALE_GETJITTERPHASECOUNT, ffxQueryDescUpscaleGetJitterPhaseCount),
+    DESCRIPTOR(FFX_API_QUERY_DESC_TYPE_UPSCALE_GETJITTEROFFSET, ffxQueryDescUpscaleGetJitterOffset),
+    DESCRIPTOR(FFX_API_DISPATCH_DESC_TYPE_UPSCALE_GENERATEREACTIVEMASK, ffxDispatchDescUpscaleGenerateReactiveMask),
+    DESCRIPTOR(FFX_API_CONFIGURE_DESC_TYPE_UPSCALE_KEYVALUE, ffxConfigureDescUpscaleKeyValue),
+    DESCRIPTOR(FFX_API_CREATE_CONTEXT_DESC_TYPE_FRAMEGENERATION, ffxCreateContextDescFrameGeneration),
+    DESCRIPTOR(FFX_API_CALLBACK_DESC_TYPE_FRAMEGENERATION_PRESENT, ffxCallbackDescFrameGenerationPresent),
+    DESCRIPTOR(FFX_API_DISPATCH_DESC_TYPE_FRAMEGENERATION, ffxDispatchDescFrameGeneration),
+    DESCRIPTOR(FFX_API_CONFIGURE_DESC_TYPE_FRAMEGENERATION, ffxConfigureDescFrameGeneration),
+    DESCRIPTOR(FFX_API_DISPATCH_DESC_TYPE_FRAMEGENERATION_PREPARE, ffxDispatchDescFrameGenerationPrepare),
+    DESCRIPTOR(FFX_API_CONFIGURE_DESC_TYPE_FRAMEGENERATION_KEYVALUE, ffxConfigureDescFrameGenerationKeyValue),
+#ifdef FSR31PROXY_DX12_DESCRIPTORS
+    DESCRIPTOR(FFX_API_CREATE_CONTEXT_DESC_TYPE_BACKEND_DX12, ffxCreateBackendDX12Desc),
+    DESCRIPTOR(FFX_API_CREATE_CONTEXT_DESC_TYPE_FRAMEGENERATIONSWAPCHAIN_WRAP_DX12, ffxCreateContextDescFrameGenerationSwapChainWrapDX12),
+    DESCRIPTOR(FFX_API_CREATE_CONTEXT_DESC_TYPE_FRAMEGENERATIONSWAPCHAIN_NEW_DX12, ffxCreateContextDescFrameGenerationSwapChainNewDX12),
+    DESCRIPTOR(FFX_API_CREATE_CONTEXT_DESC_TYPE_FRAMEGENERATIONSWAPCHAIN_FOR_HWND_DX12, ffxCreateContextDescFrameGenerationSwapChainForHwndDX12),
+    DESCRIPTOR(FFX_API_CONFIGURE_DESC_TYPE_FRAMEGENERATIONSWAPCHAIN_REGISTERUIRESOURCE_DX12, ffxConfigureDescFrameGenerationSwapChainRegisterUiResourceDX12),
+    DESCRIPTOR(FFX_API_QUERY_DESC_TYPE_FRAMEGENERATIONSWAPCHAIN_INTERPOLATIONCOMMANDLIST_DX12, ffxQueryDescFrameGenerationSwapChainInterpolationCommandListDX12),
+    DESCRIPTOR(FFX_API_QUERY_DESC_TYPE_FRAMEGENERATIONSWAPCHAIN_INTERPOLATIONTEXTURE_DX12, ffxQueryDescFrameGenerationSwapChainInterpolationTextureDX12),
+    DESCRIPTOR(FFX_API_DISPATCH_DESC_TYPE_FRAMEGENERATIONSWAPCHAIN_WAIT_FOR_PRESENTS_DX12, ffxDispatchDescFrameGenerationSwapChainWaitForPresentsDX12),
+    DESCRIPTOR(FFX_API_CONFIGURE_DESC_TYPE_FRAMEGENERATIONSWAPCHAIN_KEYVALUE_DX12, ffxConfigureDescFrameGenerationSwapChainKeyValueDX12),
+#endif
+#ifdef FSR31PROXY_VULKAN_DESCRIPTORS
+    DESCRIPTOR(FFX_API_CREATE_CONTEXT_DESC_TYPE_BACKEND_VK, ffxCreateBackendVKDesc),
+    DESCRIPTOR(FFX_API_CREATE_CONTEXT_DESC_TYPE_FGSWAPCHAIN_VK, ffxCreateContextDescFrameGenerationSwapChainVK),
+    DESCRIPTOR(FFX_API_CONFIGURE_DESC_TYPE_FGSWAPCHAIN_REGISTERUIRESOURCE_VK, ffxConfigureDescFrameGenerationSwapChainRegisterUiResourceVK),
+    DESCRIPTOR(FFX_API_QUERY_DESC_TYPE_FGSWAPCHAIN_INTERPOLATIONCOMMANDLIST_VK, ffxQueryDescFrameGenerationSwapChainInterpolationCommandListVK),
+    DESCRIPTOR(FFX_API_QUERY_DESC_TYPE_FGSWAPCHAIN_INTERPOLATIONTEXTURE_VK, ffxQueryDescFrameGenerationSwapChainInterpolationTextureVK),
+    DESCRIPTOR(FFX_API_DISPATCH_DESC_TYPE_FGSWAPCHAIN_WAIT_FOR_PRESENTS_VK, ffxDispatchDescFrameGenerationSwapChainWaitForPresentsVK),
+    DESCRIPTOR(FFX_API_CONFIGURE_DESC_TYPE_FRAMEGENERATIONSWAPCHAIN_KEYVALUE_VK, ffxConfigureDescFrameGenerationSwapChainKeyValueVK),
+    DESCRIPTOR(FFX_API_QUERY_DESC_TYPE_FGSWAPCHAIN_FUNCTIONS_VK, ffxQueryDescSwapchainReplacementFunctionsVK),
+#endif
+};
+
+// Slot of a type id in the lookup table, -1 for ids outside of it
+constexpr int descriptorSlot(uint64_t type)
+{
+    auto effect = type >> 16;
+    auto index = type & 0xffff;
+
+    if (effect >= DescriptorEffectSlots || index >= DescriptorTypeSlots)
+        return -1;
+
+    return (int)(effect * DescriptorTypeSlots + index);
+}
+
+// Dense table of _descriptors indices + 1, 0 for unknown types. Built at compile time,
+// so a lookup costs the same no matter how many types are known.
+struct DescriptorTable
+{
+    uint8_t slots[DescriptorEffectSlots * DescriptorTypeSlots] = {};
+    bool valid = true;
+};
+
+static constexpr DescriptorTable buildDescriptorTable()
+{
+    DescriptorTable table;
+
+    for (size_t i = 0; i < std::size(_descriptors); i++)
+    {
+        auto slot = descriptorSlot(_descriptors[i].type);
+
+        if (slot < 0 || table.slots[slot] != 0)
+            table.valid = false;
+        else
+            table.slots[slot] = (uint8_t)(i + 1);
+    }
+
+    return table;
+}
+
+static constexpr DescriptorTable _descriptorTable = buildDescriptorTable();
+
+static_assert(std::size(_descriptors) < 256, "Descriptor table indices are 8 bit");
+static_assert(_descriptorTable.valid, "A descriptor type doesn't fit the lookup table, raise DescriptorEffectSlots or DescriptorTypeSlots");
+
+std::span<const DescriptorInfo> knownDescriptors()
+{
+    return _descriptors;
+}
+
+const DescriptorInfo* findDescriptor(uint64_t type)
+{
+    auto slot = descriptorSlot(type);
+
+    if (slot < 0)
+        return nullptr;
+
+    auto index = _descriptorTable.slots[slot];
+    return index != 0 ? &_descriptors[index - 1] : nullptr;
+}
+
+size_t descriptorSize(uint64_t type)
+{
+    auto info = findDescriptor(type);
+    return info != nullptr ? info->size : sizeof(ffxApiHeader);
+}
+
+const char* descriptorName(uint64_t type)
+{
+    auto info = findDescriptor(type);
+    return info != nullptr ? info->name : nullptr;
+}
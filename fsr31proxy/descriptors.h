@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include "descriptor_fields.h"
+
+// Checks the contents of a captured descriptor, returns the first problem found or null
+using DescriptorValidateFn = const char* (*)(const uint8_t* data);
+
+struct DescriptorInfo
+{
+    uint64_t type;
+    uint32_t size;
+    const char* name;
+    std::span<const FieldInfo> fields;
+    DescriptorValidateFn validate;      // null when the descriptor has no checks
+};
+
+// Type ids are looked up in a table indexed by effect id and the low type bits
+constexpr uint32_t DescriptorEffectSlots = 8;
+constexpr uint32_t DescriptorTypeSlots = 16;
+
+std::span<const DescriptorInfo> knownDescriptors();
+const DescriptorInfo* findDescriptor(uint64_t type);
+size_t descriptorSize(uint64_t type);
+const char* descriptorName(uint64_t type);
@@ -1,209 +1,349 @@
 // dllmain.cpp : Defines the entry point for the DLL application.
 #include "pch.h"
 #include "log.h"
+#include "allocation_counter.h"
+#include "call_latency.h"
+#include "capture.h"
+#include "config.h"
+#include "control.h"
+#include "context_registry.h"
+#include "frame_ids.h"
+#include "frame_stats.h"
+#include "fsr31proxy.h"
+#include "provider.h"
+#include "query_cache.h"
+#include "startup.h"
+#include "timer.h"
+#include "version_cache.h"
 #include "ffx_api.h"
 #include "ffx_upscale.h"
-#include "dx12/ffx_api_dx12.h"
+#include <mutex>
 
-static HMODULE _amdDll = nullptr;
-static PfnFfxCreateContext _createContext = nullptr;
-static PfnFfxDestroyContext _destroyContext = nullptr;
-static PfnFfxConfigure _configure = nullptr;
-static PfnFfxQuery _query = nullptr;
-static PfnFfxDispatch _dispatch = nullptr;
+static std::once_flag _attachOnce;
+static std::atomic<bool> _attached{ false };
+
+static void attachProcess()
+{
+    markStartup(StartupEvent::FirstCall, timerNow());
+
+    // Only unloaded at process exit from here on, the writer and watcher threads never run
+    // in unloaded code and their stop never has to wait in DllMain
+    pinLibrary((const void*)&attachProcess);
+
+    // The config comes first, it names the log and the provider
+    loadConfig();
+    auto& config = proxyConfig();
+
+    prepareLogging(config.logFile, config.traceFile);
+    logConfig();
+    openProvider(config.providerFile.c_str());
+    startConfigWatcher();
+    markStartup(StartupEvent::ProviderLoaded, timerNow());
+}
+
+// At process exit on Windows every other thread is already gone, POSIX runs it from an exit
+// handler while they still run
+static void detachProcess(bool processExit)
+{
+    if (processExit)
+        abandonConfigWatcher();
+    else
+        stopConfigWatcher();
+
+    closeLogging(processExit);
+    closeProvider();
+}
+
+#ifndef _WIN32
+
+// Shared objects have no DllMain. Constructed on attach, after all statics the proxy uses
+// exist, so it is destroyed before them when the process exits.
+struct ProxyDetach
+{
+    ~ProxyDetach() { detachProcess(false); }
+};
+
+// Runs when the shared object is loaded, like DLL_PROCESS_ATTACH
+__attribute__((constructor)) static void markAttach()
+{
+    markStartup(StartupEvent::Attach, timerNow());
+}
+
+#endif
+
+// Logging and the provider are set up by the first exported call instead of DllMain, which
+// holds the loader lock and runs in every process that loads the proxy. Later calls only
+// load the flag.
+static void ensureAttached()
+{
+    if (_attached.load(std::memory_order_acquire))
+        return;
+
+    std::call_once(_attachOnce, []
+    {
+        attachProcess();
+#ifndef _WIN32
+        static ProxyDetach detach;
+#endif
+        _attached.store(true, std::memory_order_release);
+    });
+}
 
 FFX_API_ENTRY ffxReturnCode_t ffxCreateContext(ffxContext* context, ffxCreateContextDescHeader* desc, const ffxAllocationCallbacks* memCb)
 {
-    if (_createContext == nullptr)
+    ensureAttached();
+
+    ProviderCall provider;
+
+    if (provider->CreateContext == nullptr)
         return FFX_API_RETURN_ERROR;
 
-    log("ffxCreateContext");
+    auto timestamp = timerNow();
 
-    ffxCreateContextDescHeader* header = desc;
+    if (markStartup(StartupEvent::FirstCreate, timestamp))
+        reportStartup(timestamp - startupTime(StartupEvent::Attach));
 
-    while (header != nullptr)
-    {
-        if (header->type == FFX_API_CREATE_CONTEXT_DESC_TYPE_UPSCALE)
-        {
-            log("ffxCreateContext header->type: FFX_API_CREATE_CONTEXT_DESC_TYPE_UPSCALE");
-        }
-        else if (header->type == FFX_API_DESC_TYPE_OVERRIDE_VERSION)
-        {
-            log("ffxCreateContext header->type: FFX_API_DESC_TYPE_OVERRIDE_VERSION");
-        }
-        else if (header->type == FFX_API_CREATE_CONTEXT_DESC_TYPE_BACKEND_DX12)
-        {
-            log("ffxCreateContext header->type: FFX_API_CREATE_CONTEXT_DESC_TYPE_BACKEND_DX12");
-        }
-        else
-        {
-            log("ffxCreateContext header->type: " + std::to_string((uint64_t)header->type));
-        }
+    auto result = provider->CreateContext(context, desc, memCb);
+    auto endTimestamp = timerNow();
 
-        header = header->pNext;
-    }
+    // Counted on the table it was created through, which stays loaded until the count drops
+    auto table = provider.table();
+
+    if (result == FFX_API_RETURN_OK)
+        addProviderContext(table);
+
+    provider.leave();
+
+    recordCallLatency(CaptureEntry::CreateContext, desc != nullptr ? desc->type : 0, endTimestamp - timestamp);
+
+    if (result == FFX_API_RETURN_OK && context != nullptr)
+        registerContext(*context, desc, timestamp, table);
 
-    auto result = _createContext(context, desc, memCb);
+    captureCall(CaptureEntry::CreateContext, context != nullptr ? *context : nullptr, desc, timestamp, endTimestamp, result);
 
-    log("ffxCreateContext result: " + std::to_string((uint32_t)result));
+    recordProxyOverhead(CaptureEntry::CreateContext, desc != nullptr ? desc->type : 0, timerNow() - endTimestamp);
 
     return result;
 }
 
 FFX_API_ENTRY ffxReturnCode_t ffxDestroyContext(ffxContext* context, const ffxAllocationCallbacks* memCb)
 {
-    log("ffxDestroyContext");
+    ensureAttached();
 
-    auto result = _destroyContext(context, memCb);
+    auto entryTimestamp = timerNow();
+    auto handle = context != nullptr ? *context : nullptr;
+    auto info = context != nullptr ? findContext(handle) : nullptr;
 
-    log("ffxDestroyContext result: " + std::to_string((uint32_t)result));
+    ProviderCall provider(info);
+    retireContext(info);
+    auto timestamp = timerNow();
+
+    auto result = provider->DestroyContext(context, memCb);
+    auto endTimestamp = timerNow();
+
+    // Gone from the registry before the count drops, a replaced provider may be unloaded after
+    unregisterContext(info, result == FFX_API_RETURN_OK);
+
+    if (result == FFX_API_RETURN_OK)
+        removeProviderContext(provider.table());
+
+    provider.leave();
+
+    recordCallLatency(CaptureEntry::DestroyContext, 0, endTimestamp - timestamp);
+
+    if (result == FFX_API_RETURN_OK)
+        forgetQueries(handle);
+
+    captureCall(CaptureEntry::DestroyContext, handle, nullptr, timestamp, endTimestamp, result);
+
+    recordProxyOverhead(CaptureEntry::DestroyContext, 0, timerNow() - endTimestamp + (timestamp - entryTimestamp));
+
+    // The last context of the provider is gone, a waiting one can take over
+    swapProviderWhenIdle();
 
     return result;
 }
 
 FFX_API_ENTRY ffxReturnCode_t ffxConfigure(ffxContext* context, const ffxConfigureDescHeader* desc)
 {
-    log("ffxConfigure");
+    ensureAttached();
+
+    // Proxy keys never reach the provider, other configures only pay the type check
+    if (isControlKey(desc))
+        return handleControlKey(desc);
+
+    // The provider gets the proxy's present callback to see the frameIDs of presents
+    auto entryTimestamp = timerNow();
+    auto info = context != nullptr ? findContext(*context) : nullptr;
+    ffxConfigureDescFrameGeneration wrapped;
+    auto forwarded = info != nullptr ? wrapPresentCallback(info->frameIds, desc, wrapped) : desc;
+
+    ProviderCall provider(info);
+    auto timestamp = timerNow();
 
-    auto result = _configure(context, desc);
+    auto result = provider->Configure(context, forwarded);
+    auto endTimestamp = timerNow();
+    provider.leave();
 
-    log("ffxConfigure result: " + std::to_string((uint32_t)result));
+    recordCallLatency(CaptureEntry::Configure, desc != nullptr ? desc->type : 0, endTimestamp - timestamp);
+
+    if (info != nullptr)
+    {
+        countContextCall(info, CaptureEntry::Configure, result, timestamp);
+
+        if (result == FFX_API_RETURN_OK)
+        {
+            commitPresentCallback(info->frameIds, desc, forwarded);
+            checkFrameId(info->frameIds, desc, CALLER_ADDRESS());
+        }
+    }
+
+    captureCall(CaptureEntry::Configure, context != nullptr ? *context : nullptr, desc, timestamp, endTimestamp, result);
+
+    // The context lookup and wrapping the present callback before the call are the proxy's time too
+    recordProxyOverhead(CaptureEntry::Configure, desc != nullptr ? desc->type : 0, timerNow() - endTimestamp + (timestamp - entryTimestamp));
 
     return result;
 }
 
 FFX_API_ENTRY ffxReturnCode_t ffxQuery(ffxContext* context, ffxQueryDescHeader* desc)
 {
-    log("ffxQuery");
+    ensureAttached();
+
+    auto handle = context != nullptr ? *context : nullptr;
+    auto timestamp = timerNow();
+
+    // Lookup and store see the same cache settings, even when a reload comes in between
+    auto& config = proxyConfig();
+
+    // Repeated pure queries are answered without the provider, the whole call is proxy time
+    if (lookupQuery(handle, desc, config.queryCache) || lookupVersions(desc, config.versionCache))
+    {
+        auto endTimestamp = timerNow();
+
+        countVersionQuery(desc, endTimestamp - timestamp, true);
+
+        if (auto info = context != nullptr ? findContext(handle) : nullptr)
+            countContextCall(info, CaptureEntry::Query, FFX_API_RETURN_OK, timestamp);
+
+        captureCall(CaptureEntry::Query, handle, desc, timestamp, endTimestamp, FFX_API_RETURN_OK, CaptureFlagCached);
+
+        recordProxyOverhead(CaptureEntry::Query, desc->type, timerNow() - timestamp);
+
+        return FFX_API_RETURN_OK;
+    }
+
+    auto info = context != nullptr ? findContext(handle) : nullptr;
+
+    ProviderCall provider(info);
+    auto callTimestamp = timerNow();
+    auto result = provider->Query(context, desc);
+    auto endTimestamp = timerNow();
+    provider.leave();
+
+    recordCallLatency(CaptureEntry::Query, desc != nullptr ? desc->type : 0, endTimestamp - callTimestamp);
+
+    countVersionQuery(desc, endTimestamp - timestamp, false);
+
+    if (result == FFX_API_RETURN_OK)
+    {
+        storeQuery(handle, desc, config.queryCache);
+        storeVersions(desc);
+    }
+
+    if (info != nullptr)
+        countContextCall(info, CaptureEntry::Query, result, callTimestamp);
 
-    auto result = _query(context, desc);
+    captureCall(CaptureEntry::Query, handle, desc, callTimestamp, endTimestamp, result);
 
-    log("ffxQuery result: " + std::to_string((uint32_t)result));
+    // The cache lookups and the context lookup before the call are the proxy's time too
+    recordProxyOverhead(CaptureEntry::Query, desc != nullptr ? desc->type : 0, timerNow() - endTimestamp + (callTimestamp - timestamp));
 
     return result;
 }
 
 FFX_API_ENTRY ffxReturnCode_t ffxDispatch(ffxContext* context, const ffxDispatchDescHeader* desc)
 {
-    log("ffxDispatch");
+    ensureAttached();
 
-    if (desc->type == FFX_API_DISPATCH_DESC_TYPE_UPSCALE)
-    {
-        log("ffxDispatch desc->type: FFX_API_DISPATCH_DESC_TYPE_UPSCALE");
-        auto ud = (ffxDispatchDescUpscale*)desc;
-
-        log("ffxDispatch ud->cameraFar: " + std::to_string(ud->cameraFar));
-        log("ffxDispatch ud->cameraFovAngleVertical: " + std::to_string(ud->cameraFovAngleVertical));
-        log("ffxDispatch ud->cameraNear: " + std::to_string(ud->cameraNear));
-
-        if (ud->color.resource != nullptr)
-            log("ffxDispatch ud->color: not null");
-        else
-            log("ffxDispatch ud->color: null");
-
-        if (ud->commandList != nullptr)
-            log("ffxDispatch ud->commandList: not null");
-        else
-            log("ffxDispatch ud->commandList: null");
-
-        if (ud->depth.resource != nullptr)
-            log("ffxDispatch ud->depth: not null");
-        else
-            log("ffxDispatch ud->depth: null");
-
-        if (ud->enableSharpening)
-            log("ffxDispatch ud->enableSharpening: true");
-        else
-            log("ffxDispatch ud->enableSharpening: false");
-
-        if (ud->exposure.resource != nullptr)
-            log("ffxDispatch ud->exposure: not null");
-        else
-            log("ffxDispatch ud->exposure: null");
-
-        log("ffxDispatch ud->flags: " + std::to_string(ud->flags));
-        log("ffxDispatch ud->frameTimeDelta: " + std::to_string(ud->frameTimeDelta));
-        log("ffxDispatch ud->jitterOffset: {" + std::to_string(ud->jitterOffset.x) + ", " + std::to_string(ud->jitterOffset.y) + "}");
-
-        if (ud->motionVectors.resource != nullptr)
-            log("ffxDispatch ud->motionVectors: not null");
-        else
-            log("ffxDispatch ud->motionVectors: null");
-
-        log("ffxDispatch ud->motionVectorScale: {" + std::to_string(ud->motionVectorScale.x) + ", " + std::to_string(ud->motionVectorScale.y) + "}");
-
-        if ((ud->output.resource != nullptr))
-            log("ffxDispatch ud->output: not null");
-        else
-            log("ffxDispatch ud->output: null");
-
-        log("ffxDispatch ud->preExposure: " + std::to_string(ud->preExposure));
-
-        if ((ud->reactive.resource != nullptr))
-            log("ffxDispatch ud->reactive: not null");
-        else
-            log("ffxDispatch ud->reactive: null");
-
-        log("ffxDispatch ud->renderSize: {" + std::to_string(ud->renderSize.width) + ", " + std::to_string(ud->renderSize.height) + "}");
-        log("ffxDispatch ud->reset: " + std::to_string(ud->reset));
-        log("ffxDispatch ud->sharpness: " + std::to_string(ud->sharpness));
-
-        if (ud->transparencyAndComposition.resource != nullptr)
-            log("ffxDispatch ud->transparencyAndComposition: not null");
-        else
-            log("ffxDispatch ud->transparencyAndComposition: null");
-
-        log("ffxDispatch ud->upscaleSize: {" + std::to_string(ud->upscaleSize.width) + ", " + std::to_string(ud->upscaleSize.height) + "}");
-        log("ffxDispatch ud->viewSpaceToMetersFactor: " + std::to_string(ud->viewSpaceToMetersFactor));
-    }
-    else if (desc->type == FFX_API_DISPATCH_DESC_TYPE_UPSCALE_GENERATEREACTIVEMASK)
+    NoAllocationScope noAllocations;
+
+    auto entryTimestamp = timerNow();
+    auto info = context != nullptr ? findContext(*context) : nullptr;
+
+    ProviderCall provider(info);
+    auto timestamp = timerNow();
+
+    auto result = provider->Dispatch(context, desc);
+    auto endTimestamp = timerNow();
+    provider.leave();
+
+    recordCallLatency(CaptureEntry::Dispatch, desc != nullptr ? desc->type : 0, endTimestamp - timestamp);
+
+    if (info != nullptr)
     {
-        log("ffxDispatch desc->type: FFX_API_DISPATCH_DESC_TYPE_UPSCALE_GENERATEREACTIVEMASK");
+        countContextCall(info, CaptureEntry::Dispatch, result, timestamp);
+
+        if (result == FFX_API_RETURN_OK)
+            checkFrameId(info->frameIds, desc, CALLER_ADDRESS());
     }
-    else
+
+    if (result == FFX_API_RETURN_OK)
     {
-        log("ffxDispatch desc->type: " + std::to_string((uint64_t)desc->type));
+        markStartup(StartupEvent::FirstDispatch, timestamp);
+        recordFrame(desc, timestamp);
     }
 
-    auto result = _dispatch(context, desc);
+    captureCall(CaptureEntry::Dispatch, context != nullptr ? *context : nullptr, desc, timestamp, endTimestamp, result);
 
-    log("ffxDispatch result: " + std::to_string((uint32_t)result));
+    // The context lookup before the call is the proxy's time too
+    recordProxyOverhead(CaptureEntry::Dispatch, desc != nullptr ? desc->type : 0, timerNow() - endTimestamp + (timestamp - entryTimestamp));
 
     return result;
 }
 
-BOOL APIENTRY DllMain(HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReserved)
+FFX_API_ENTRY ffxReturnCode_t fsr31proxySwapProvider(const char* fileName)
 {
-    switch (ul_reason_for_call)
-    {
-        case DLL_PROCESS_ATTACH:
-            DisableThreadLibraryCalls(hModule);
+    ensureAttached();
+
+    return requestProviderSwap(fileName) ? FFX_API_RETURN_OK : FFX_API_RETURN_ERROR;
+}
 
-            prepareLogging("fsr31proxy.log");
+FFX_API_ENTRY void fsr31proxyShutdown()
+{
+    if (!_attached.load(std::memory_order_acquire))
+        return;
 
-            _amdDll = LoadLibrary(L"amd_fidelityfx_dx12.o.dll");
+    stopConfigWatcher();
+    closeLogging();
+}
 
-            if (_amdDll != nullptr)
-            {
-                _createContext = (PfnFfxCreateContext)GetProcAddress(_amdDll, "ffxCreateContext");
-                _destroyContext = (PfnFfxDestroyContext)GetProcAddress(_amdDll, "ffxDestroyContext");
-                _configure = (PfnFfxConfigure)GetProcAddress(_amdDll, "ffxConfigure");
-                _query = (PfnFfxQuery)GetProcAddress(_amdDll, "ffxQuery");
-                _dispatch = (PfnFfxDispatch)GetProcAddress(_amdDll, "ffxDispatch");
-            }
+#ifdef _WIN32
 
+BOOL APIENTRY DllMain(HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReserved)
+{
+    switch (ul_reason_for_call)
+    {
+        case DLL_PROCESS_ATTACH:
+            markStartup(StartupEvent::Attach, timerNow());
             break;
 
         case DLL_THREAD_ATTACH:
+            break;
+
         case DLL_THREAD_DETACH:
+            // Hands the thread's capture ring back once it is drained
+            releaseCaptureThread();
             break;
 
         case DLL_PROCESS_DETACH:
-            closeLogging();
-            FreeLibrary(_amdDll);
+            // Pinned once attached, so this is process exit
+            if (_attached.load(std::memory_order_acquire))
+                detachProcess(lpReserved != nullptr);
             break;
     }
 
     return TRUE;
 }
 
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+// The ffx headers export with __declspec(dllexport), GCC and Clang use symbol visibility.
+// Included before the first ffx header by whatever builds on POSIX.
+#if !defined(_MSC_VER) && !defined(__declspec)
+#define __declspec(x) __attribute__((visibility("default")))
+#endif
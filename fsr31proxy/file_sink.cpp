@@ -0,0 +1,211 @@
+#include "pch.h"
+#include "file_sink.h"
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+FileSink::~FileSink()
+{
+    close();
+}
+
+std::string FileSink::segmentName(uint64_t index) const
+{
+    return _base + "." + std::to_string(index) + _extension;
+}
+
+// prefix, a segment number and extension, e.g. fsr31proxy.3.log for "fsr31proxy." and ".log"
+static bool isSegment(const std::string& name, const std::string& prefix, const std::string& extension)
+{
+    if (name.size() <= prefix.size() + extension.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+        name.compare(name.size() - extension.size(), extension.size(), extension) != 0)
+        return false;
+
+    return name.find_first_not_of("0123456789", prefix.size()) == name.size() - extension.size();
+}
+
+bool FileSink::open(const std::string& fileName, size_t segmentSize, uint32_t segmentCount)
+{
+    close();
+
+    std::filesystem::path path(fileName);
+    _extension = path.extension().string();
+    _base = (path.parent_path() / path.stem()).string();
+    _segmentSize = segmentSize;
+    _segmentCount = segmentCount > 0 ? segmentCount : 1;
+    _segmentIndex = 0;
+
+    // Segments of the previous session would never be rotated out, they are kept aside as
+    // name.prev.N.ext and the ones of the session before it are dropped. A segment still open
+    // in another process can't be renamed on Windows and is left alone, on POSIX that process
+    // keeps writing into the renamed file.
+    std::error_code error;
+    auto directory = path.parent_path().empty() ? std::filesystem::path(".") : path.parent_path();
+    auto prefix = path.stem().string() + ".";
+    auto previousPrefix = prefix + "prev.";
+    std::vector<std::filesystem::path> previous;
+    std::vector<std::filesystem::path> older;
+
+    for (auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        auto name = entry.path().filename().string();
+
+        if (isSegment(name, previousPrefix, _extension))
+            older.push_back(entry.path());
+        else if (isSegment(name, prefix, _extension))
+            previous.push_back(entry.path());
+    }
+
+    for (auto& file : older)
+        std::filesystem::remove(file, error);
+
+    for (auto& file : previous)
+    {
+        auto name = file.filename().string();
+        std::filesystem::rename(file, directory / (previousPrefix + name.substr(prefix.size())), error);
+    }
+
+    return openSegment();
+}
+
+bool FileSink::openSegment()
+{
+    auto name = segmentName(_segmentIndex);
+
+#ifdef _WIN32
+    _file = CreateFileA(name.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (_file == INVALID_HANDLE_VALUE)
+    {
+        _file = nullptr;
+        return false;
+    }
+
+    // Preallocate the whole segment so writes never grow the file
+    LARGE_INTEGER size;
+    size.QuadPart = (LONGLONG)_segmentSize;
+    _mapping = CreateFileMappingA(_file, nullptr, PAGE_READWRITE, (DWORD)(size.QuadPart >> 32), (DWORD)size.QuadPart, nullptr);
+    if (_mapping != nullptr)
+        _view = (char*)MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, _segmentSize);
+#else
+    _file = ::open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_file < 0)
+        return false;
+
+    if (posix_fallocate(_file, 0, (off_t)_segmentSize) == 0)
+    {
+        auto view = mmap(nullptr, _segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, _file, 0);
+        _view = view != MAP_FAILED ? (char*)view : nullptr;
+    }
+#endif
+
+    if (_view == nullptr)
+    {
+        closeSegment();
+        return false;
+    }
+
+    _used = 0;
+
+    if (_segmentIndex >= _segmentCount)
+    {
+        std::error_code error;
+        std::filesystem::remove(segmentName(_segmentIndex - _segmentCount), error);
+    }
+
+    if (!_preamble.empty() && _preamble.size() <= _segmentSize)
+    {
+        memcpy(_view, _preamble.data(), _preamble.size());
+        _used = _preamble.size();
+    }
+
+    return true;
+}
+
+// Unmaps the segment and cuts off the unused preallocated tail
+void FileSink::closeSegment()
+{
+#ifdef _WIN32
+    if (_view != nullptr)
+        UnmapViewOfFile(_view);
+
+    if (_mapping != nullptr)
+        CloseHandle(_mapping);
+
+    if (_file != nullptr)
+    {
+        LARGE_INTEGER size;
+        size.QuadPart = (LONGLONG)_used;
+        SetFilePointerEx(_file, size, nullptr, FILE_BEGIN);
+        SetEndOfFile(_file);
+        CloseHandle(_file);
+    }
+
+    _mapping = nullptr;
+    _file = nullptr;
+#else
+    if (_view != nullptr)
+        munmap(_view, _segmentSize);
+
+    if (_file >= 0)
+    {
+        if (ftruncate(_file, (off_t)_used) != 0)
+            _used = 0;
+
+        ::close(_file);
+    }
+
+    _file = -1;
+#endif
+
+    _view = nullptr;
+}
+
+void FileSink::close()
+{
+    closeSegment();
+    _used = 0;
+}
+
+void FileSink::setPreamble(const std::string& preamble)
+{
+    _preamble = preamble;
+
+    if (_view != nullptr && _used == 0 && _preamble.size() <= _segmentSize)
+    {
+        memcpy(_view, _preamble.data(), _preamble.size());
+        _used = _preamble.size();
+    }
+}
+
+char* FileSink::reserve(size_t size)
+{
+    if (_view == nullptr || size > _segmentSize - _preamble.size())
+        return nullptr;
+
+    if (_used + size > _segmentSize)
+    {
+        closeSegment();
+        _segmentIndex++;
+
+        if (!openSegment())
+            return nullptr;
+    }
+
+    return _view + _used;
+}
+
+void FileSink::write(const char* data, size_t size)
+{
+    auto target = reserve(size);
+    if (target == nullptr)
+        return;
+
+    memcpy(target, data, size);
+    commit(size);
+}
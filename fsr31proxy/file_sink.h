@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Writes into fixed size, preallocated segment files through a memory mapping.
+// When a segment fills up the sink moves on to the next one and deletes the oldest,
+// so at most segmentCount segments exist. Segments are named name.N.ext, opening moves the
+// previous session's to name.prev.N.ext.
+// Not thread-safe, only the capture writer thread uses it.
+class FileSink
+{
+public:
+    FileSink() = default;
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+    ~FileSink();
+
+    bool open(const std::string& fileName, size_t segmentSize, uint32_t segmentCount);
+    void close();
+    bool isOpen() const { return _view != nullptr; }
+
+    // Written at the start of every segment, so each one can be read on its own
+    void setPreamble(const std::string& preamble);
+
+    // Returns space for size bytes that stays in one segment, data is kept after commit
+    char* reserve(size_t size);
+    void commit(size_t size) { _used += size; }
+
+    void write(const char* data, size_t size);
+
+private:
+    bool openSegment();
+    void closeSegment();
+    std::string segmentName(uint64_t index) const;
+
+    std::string _base;
+    std::string _extension;
+    std::string _preamble;
+    size_t _segmentSize = 0;
+    uint32_t _segmentCount = 0;
+    uint64_t _segmentIndex = 0;
+    size_t _used = 0;
+    char* _view = nullptr;
+#ifdef _WIN32
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#else
+    int _file = -1;
+#endif
+};
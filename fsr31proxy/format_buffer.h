@@ -0,0 +1,92 @@
+#pragma once
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+// Fixed capacity text buffer for the record formatters. Appending never allocates, output
+// that doesn't fit is cut off and marks the buffer as truncated.
+class FormatBuffer
+{
+public:
+    static constexpr size_t Capacity = 16 * 1024;
+
+    FormatBuffer() = default;
+    FormatBuffer(const FormatBuffer&) = delete;
+    FormatBuffer& operator=(const FormatBuffer&) = delete;
+
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+    bool truncated() const { return _truncated; }
+    std::string_view view() const { return std::string_view(_data, _size); }
+
+    void clear()
+    {
+        _size = 0;
+        _truncated = false;
+    }
+
+    FormatBuffer& append(const char* text, size_t length)
+    {
+        if (length > Capacity - _size)
+        {
+            length = Capacity - _size;
+            _truncated = true;
+        }
+
+        memcpy(_data + _size, text, length);
+        _size += length;
+        return *this;
+    }
+
+    FormatBuffer& append(std::string_view text)
+    {
+        return append(text.data(), text.size());
+    }
+
+    FormatBuffer& append(char c)
+    {
+        return append(&c, 1);
+    }
+
+    // Integers in decimal, floats in the shortest form that reads back to the same value
+    template <typename T>
+    FormatBuffer& appendNumber(T value)
+    {
+        static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "appendNumber takes integers and floats");
+
+        auto result = std::to_chars(_data + _size, _data + Capacity, value);
+
+        if (result.ec == std::errc())
+            _size = result.ptr - _data;
+        else
+            _truncated = true;
+
+        return *this;
+    }
+
+    FormatBuffer& appendBool(bool value)
+    {
+        return append(value ? std::string_view("true") : std::string_view("false"));
+    }
+
+    FormatBuffer& appendHex(const uint8_t* data, size_t size)
+    {
+        static const char digits[] = "0123456789abcdef";
+
+        for (size_t i = 0; i < size; i++)
+        {
+            char pair[2] = { digits[data[i] >> 4], digits[data[i] & 0xf] };
+            append(pair, sizeof(pair));
+        }
+
+        return *this;
+    }
+
+private:
+    char _data[Capacity];
+    size_t _size = 0;
+    bool _truncated = false;
+};
@@ -0,0 +1,227 @@
+#include "pch.h"
+#include "frame_ids.h"
+#include "log.h"
+#include "platform.h"
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct FrameIdProblems
+{
+    std::atomic<uint64_t> checked{ 0 };
+    std::atomic<uint64_t> gaps{ 0 };
+    std::atomic<uint64_t> missing{ 0 };     // frames skipped over by the gaps
+    std::atomic<uint64_t> repeats{ 0 };
+    std::atomic<uint64_t> reorders{ 0 };
+    std::atomic<const void*> lastCaller{ nullptr };
+};
+
+static FrameIdProblems _problems[(size_t)FrameIdSource::Count];
+
+// What the proxy's present callback forwards to, never changed once created
+struct PresentTarget
+{
+    FfxApiPresentCallbackFunc callback;
+    void* userContext;
+    FrameIdState* state;
+    uint64_t context;
+};
+
+// Targets are never freed, a context usually sets one so this grows with contexts created
+static std::mutex _targetLock;
+static std::vector<std::unique_ptr<PresentTarget>> _targets;
+
+static const char* sourceName(FrameIdSource source)
+{
+    switch (source)
+    {
+        case FrameIdSource::Configure: return "configure";
+        case FrameIdSource::Prepare: return "prepare";
+        case FrameIdSource::Dispatch: return "dispatch";
+        case FrameIdSource::Present: return "present";
+        default: return "unknown";
+    }
+}
+
+void resetFrameIds(FrameIdState& state, uint64_t context)
+{
+    state.context.store(context, std::memory_order_relaxed);
+
+    for (auto& track : state.tracks)
+    {
+        track.last.store(0, std::memory_order_relaxed);
+        track.seen.store(false, std::memory_order_relaxed);
+        track.logged.store(0, std::memory_order_relaxed);
+    }
+}
+
+static void logProblem(const FrameIdState& state, FrameIdSource source, const char* problem, uint64_t frameId, uint64_t last, const void* caller)
+{
+    if (!logEnabled<LogLevel::Warning>(LogCategoryFrameGeneration))
+        return;
+
+    char module[64];
+    auto offset = moduleOffset(caller, module, sizeof(module));
+    char text[256];
+
+    auto length = module[0] != 0 ?
+        snprintf(text, sizeof(text), "frameID %s: context %llu %s %llu after %llu, called from %s+0x%llx", problem, (unsigned long long)state.context.load(std::memory_order_relaxed),
+            sourceName(source), (unsigned long long)frameId, (unsigned long long)last, module, (unsigned long long)offset) :
+        snprintf(text, sizeof(text), "frameID %s: context %llu %s %llu after %llu, called from 0x%llx", problem, (unsigned long long)state.context.load(std::memory_order_relaxed),
+            sourceName(source), (unsigned long long)frameId, (unsigned long long)last, (unsigned long long)(uintptr_t)caller);
+
+    if (length > 0)
+        log(LogLevel::Warning, LogCategoryFrameGeneration, text, sizeof(text));
+}
+
+static void checkSource(FrameIdState& state, FrameIdSource source, uint64_t frameId, const void* caller, bool allowRepeat)
+{
+    auto& track = state.tracks[(size_t)source];
+    auto& problems = _problems[(size_t)source];
+
+    problems.checked.fetch_add(1, std::memory_order_relaxed);
+
+    auto last = track.last.exchange(frameId, std::memory_order_relaxed);
+
+    if (!track.seen.exchange(true, std::memory_order_relaxed) || frameId == last + 1 || (frameId == last && allowRepeat))
+        return;
+
+    const char* problem;
+
+    if (frameId == last)
+    {
+        problems.repeats.fetch_add(1, std::memory_order_relaxed);
+        problem = "repeat";
+    }
+    else if (frameId < last)
+    {
+        problems.reorders.fetch_add(1, std::memory_order_relaxed);
+        problem = "reorder";
+    }
+    else
+    {
+        problems.gaps.fetch_add(1, std::memory_order_relaxed);
+        problems.missing.fetch_add(frameId - last - 1, std::memory_order_relaxed);
+        problem = "gap";
+    }
+
+    problems.lastCaller.store(caller, std::memory_order_relaxed);
+
+    if (track.logged.fetch_add(1, std::memory_order_relaxed) < FrameIdLoggedProblems)
+        logProblem(state, source, problem, frameId, last, caller);
+}
+
+void checkFrameId(FrameIdState& state, const ffxApiHeader* desc, const void* caller)
+{
+    if (desc == nullptr)
+        return;
+
+    switch (desc->type)
+    {
+        case FFX_API_CONFIGURE_DESC_TYPE_FRAMEGENERATION:
+            checkSource(state, FrameIdSource::Configure, ((const ffxConfigureDescFrameGeneration*)desc)->frameID, caller, false);
+            break;
+
+        case FFX_API_DISPATCH_DESC_TYPE_FRAMEGENERATION_PREPARE:
+            checkSource(state, FrameIdSource::Prepare, ((const ffxDispatchDescFrameGenerationPrepare*)desc)->frameID, caller, false);
+            break;
+
+        case FFX_API_DISPATCH_DESC_TYPE_FRAMEGENERATION:
+            checkSource(state, FrameIdSource::Dispatch, ((const ffxDispatchDescFrameGeneration*)desc)->frameID, caller, false);
+            break;
+    }
+}
+
+// Generated and rendered images of a frame are presented with the same frameID. A present
+// after its context's slot was reused still reaches the app, only the check is skipped.
+static ffxReturnCode_t presentCallback(ffxCallbackDescFrameGenerationPresent* params, void* userContext)
+{
+    auto target = (const PresentTarget*)userContext;
+
+    if (target->state->context.load(std::memory_order_relaxed) == target->context)
+        checkSource(*target->state, FrameIdSource::Present, params->frameID, CALLER_ADDRESS(), true);
+
+    return target->callback(params, target->userContext);
+}
+
+static bool matches(const PresentTarget* target, const FrameIdState& state, FfxApiPresentCallbackFunc callback, void* userContext)
+{
+    return target != nullptr && target->callback == callback && target->userContext == userContext &&
+        target->state == &state && target->context == state.context.load(std::memory_order_relaxed);
+}
+
+static const PresentTarget* findTarget(FrameIdState& state, FfxApiPresentCallbackFunc callback, void* userContext)
+{
+    auto committed = state.present.load(std::memory_order_acquire);
+
+    if (matches(committed, state, callback, userContext))
+        return committed;
+
+    std::lock_guard lock(_targetLock);
+
+    for (auto it = _targets.rbegin(); it != _targets.rend(); ++it)
+    {
+        if (matches(it->get(), state, callback, userContext))
+            return it->get();
+    }
+
+    _targets.push_back(std::make_unique<PresentTarget>(PresentTarget{ callback, userContext, &state, state.context.load(std::memory_order_relaxed) }));
+    return _targets.back().get();
+}
+
+const ffxApiHeader* wrapPresentCallback(FrameIdState& state, const ffxApiHeader* desc, ffxConfigureDescFrameGeneration& wrapped)
+{
+    if (desc == nullptr || desc->type != FFX_API_CONFIGURE_DESC_TYPE_FRAMEGENERATION)
+        return desc;
+
+    memcpy(&wrapped, desc, sizeof(wrapped));
+
+    if (wrapped.presentCallback == nullptr || wrapped.presentCallback == presentCallback)
+        return desc;
+
+    // pNext still points into the app's chain
+    wrapped.presentCallbackUserContext = (void*)findTarget(state, wrapped.presentCallback, wrapped.presentCallbackUserContext);
+    wrapped.presentCallback = presentCallback;
+    return &wrapped.header;
+}
+
+void commitPresentCallback(FrameIdState& state, const ffxApiHeader* desc, const ffxApiHeader* forwarded)
+{
+    if (forwarded == desc)
+        return;
+
+    auto& wrapped = *(const ffxConfigureDescFrameGeneration*)forwarded;
+    state.present.store((const PresentTarget*)wrapped.presentCallbackUserContext, std::memory_order_release);
+}
+
+void reportFrameIds(FormatBuffer& out, std::string_view time)
+{
+    for (uint32_t i = 0; i < (uint32_t)FrameIdSource::Count; i++)
+    {
+        auto& problems = _problems[i];
+        auto checked = problems.checked.load(std::memory_order_relaxed);
+
+        if (checked == 0)
+            continue;
+
+        out.append('[').append(time).append("] frameID ").append(sourceName((FrameIdSource)i)).append(": ").appendNumber(checked).append(" checked, ");
+        out.appendNumber(problems.gaps.load(std::memory_order_relaxed)).append(" gaps (").appendNumber(problems.missing.load(std::memory_order_relaxed)).append(" frames missing), ");
+        out.appendNumber(problems.repeats.load(std::memory_order_relaxed)).append(" repeats, ").appendNumber(problems.reorders.load(std::memory_order_relaxed)).append(" reorders");
+
+        if (auto caller = problems.lastCaller.load(std::memory_order_relaxed))
+        {
+            char module[64];
+            char site[96];
+            auto offset = moduleOffset(caller, module, sizeof(module));
+            auto length = module[0] != 0 ?
+                snprintf(site, sizeof(site), "%s+0x%llx", module, (unsigned long long)offset) :
+                snprintf(site, sizeof(site), "0x%llx", (unsigned long long)(uintptr_t)caller);
+
+            if (length > 0)
+                out.append(", last from ").append(std::string_view(site, (size_t)length < sizeof(site) ? (size_t)length : sizeof(site) - 1));
+        }
+
+        out.append('\n');
+    }
+}
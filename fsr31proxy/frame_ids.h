@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include "ffx_api.h"
+#include "ffx_framegeneration.h"
+#include "format_buffer.h"
+
+// Frame generation descriptors that carry a frameID, each one must count up by exactly one
+// on its own or frame generation resets
+enum class FrameIdSource : uint32_t
+{
+    Configure,      // ffxConfigureDescFrameGeneration
+    Prepare,        // ffxDispatchDescFrameGenerationPrepare
+    Dispatch,       // ffxDispatchDescFrameGeneration
+    Present,        // ffxCallbackDescFrameGenerationPresent, seen through the proxy's present callback
+    Count
+};
+
+// Problems logged per context and source, later ones are only counted
+constexpr uint32_t FrameIdLoggedProblems = 8;
+
+struct FrameIdTrack
+{
+    std::atomic<uint64_t> last{ 0 };
+    std::atomic<bool> seen{ false };
+    std::atomic<uint32_t> logged{ 0 };
+};
+
+struct PresentTarget;
+
+// Per context, lives in its ContextInfo
+struct FrameIdState
+{
+    std::atomic<uint64_t> context{ 0 };
+    FrameIdTrack tracks[(size_t)FrameIdSource::Count];
+
+    // Last present callback the provider accepted, so a configure that repeats it forwards
+    // the same target without taking the lock. Kept across slot reuse, it names its context.
+    std::atomic<const PresentTarget*> present{ nullptr };
+};
+
+void resetFrameIds(FrameIdState& state, uint64_t context);
+
+// Checks the frameID of the first descriptor of a successful configure or dispatch, caller
+// is the call site in the app the problems are attributed to. A few relaxed atomics per call.
+void checkFrameId(FrameIdState& state, const ffxApiHeader* desc, const void* caller);
+
+// A frame generation configure with a present callback is copied into wrapped with the proxy's
+// callback in its place, which is returned to forward instead of desc. The provider's user
+// context is an immutable target holding the app's callback and user context, targets live
+// for the process so a late present never pairs the wrong ones or reaches freed memory.
+const ffxApiHeader* wrapPresentCallback(FrameIdState& state, const ffxApiHeader* desc, ffxConfigureDescFrameGeneration& wrapped);
+
+// Remembers the target of a wrapped configure once the provider returned OK, forwarded is
+// what wrapPresentCallback returned for desc
+void commitPresentCallback(FrameIdState& state, const ffxApiHeader* desc, const ffxApiHeader* forwarded);
+
+// Gaps, repeats and reorders per source over all contexts, with the last call site of each
+void reportFrameIds(FormatBuffer& out, std::string_view time);
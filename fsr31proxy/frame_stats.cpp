@@ -0,0 +1,255 @@
+#include "pch.h"
+#include "frame_stats.h"
+#include "histogram.h"
+#include "timer.h"
+#include "ffx_upscale.h"
+#include "ffx_framegeneration.h"
+#include <atomic>
+#include <thread>
+
+// Frame times in microseconds, 64 sub-buckets keep the lows within 2%
+using FrameTimeHistogram = Histogram<6, 32>;
+
+// Weight of a new frame in the recent average the stutter check compares against
+constexpr double FrameStatsAverageWeight = 1.0 / 16.0;
+
+struct FrameSeries
+{
+    FrameTimeHistogram histogram;
+    std::atomic<uint64_t> stutters{ 0 };
+    std::atomic<uint64_t> worstStutter{ 0 };    // microseconds
+    double average = 0.0;                       // only touched while recording
+};
+
+static FrameSeries _measured;
+static FrameSeries _reported;
+static std::atomic<bool> _upscaleFrames{ false };
+static std::atomic<uint64_t> _frames{ 0 };
+static std::atomic<uint64_t> _pauses{ 0 };
+static std::atomic<uint64_t> _concurrent{ 0 };
+static std::atomic<uint64_t> _windows{ 0 };
+static std::atomic<uint64_t> _driftWindows{ 0 };
+static std::atomic<int64_t> _worstDrift{ 0 };   // hundredths of a percent of the measured time
+
+// Only one thread records a frame at a time, the others just count theirs
+static std::atomic_flag _recording = ATOMIC_FLAG_INIT;
+static uint64_t _lastFrame = 0;
+static uint64_t _windowMeasured = 0;
+static uint64_t _windowReported = 0;
+static uint32_t _windowFrames = 0;
+
+bool isFrameDispatch(uint64_t type)
+{
+    if (type == FFX_API_DISPATCH_DESC_TYPE_UPSCALE)
+    {
+        _upscaleFrames.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    return type == FFX_API_DISPATCH_DESC_TYPE_FRAMEGENERATION_PREPARE && !_upscaleFrames.load(std::memory_order_relaxed);
+}
+
+static float reportedFrameTime(const ffxApiHeader* desc)
+{
+    switch (desc->type)
+    {
+        case FFX_API_DISPATCH_DESC_TYPE_UPSCALE: return ((const ffxDispatchDescUpscale*)desc)->frameTimeDelta;
+        case FFX_API_DISPATCH_DESC_TYPE_FRAMEGENERATION_PREPARE: return ((const ffxDispatchDescFrameGenerationPrepare*)desc)->frameTimeDelta;
+        default: return 0.0f;
+    }
+}
+
+static void recordSeries(FrameSeries& series, uint64_t micros)
+{
+    series.histogram.record(micros);
+
+    if (series.average > 0.0 && (double)micros * 100.0 > series.average * FrameStatsStutterPercent)
+    {
+        series.stutters.fetch_add(1, std::memory_order_relaxed);
+
+        if (micros > series.worstStutter.load(std::memory_order_relaxed))
+            series.worstStutter.store(micros, std::memory_order_relaxed);
+    }
+
+    if (series.average > 0.0)
+        series.average += ((double)micros - series.average) * FrameStatsAverageWeight;
+    else
+        series.average = (double)micros;
+}
+
+static void resetDriftWindow()
+{
+    _windowMeasured = 0;
+    _windowReported = 0;
+    _windowFrames = 0;
+}
+
+// The reported time of a frame is usually the one before it, over a window that evens out
+static void updateDrift(uint64_t measured, uint64_t reported)
+{
+    _windowMeasured += measured;
+    _windowReported += reported;
+
+    if (++_windowFrames < FrameStatsDriftWindow)
+        return;
+
+    if (_windowMeasured > 0)
+    {
+        auto drift = ((int64_t)_windowReported - (int64_t)_windowMeasured) * 10000 / (int64_t)_windowMeasured;
+        auto size = drift < 0 ? -drift : drift;
+        auto worst = _worstDrift.load(std::memory_order_relaxed);
+
+        _windows.fetch_add(1, std::memory_order_relaxed);
+
+        if (size > (int64_t)FrameStatsDriftPercent * 100)
+            _driftWindows.fetch_add(1, std::memory_order_relaxed);
+
+        if (size > (worst < 0 ? -worst : worst))
+            _worstDrift.store(drift, std::memory_order_relaxed);
+    }
+
+    resetDriftWindow();
+}
+
+void recordFrame(const ffxApiHeader* desc, uint64_t timestamp)
+{
+    if (desc == nullptr || !isFrameDispatch(desc->type))
+        return;
+
+    _frames.fetch_add(1, std::memory_order_relaxed);
+
+    if (_recording.test_and_set(std::memory_order_acquire))
+    {
+        _concurrent.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto last = _lastFrame;
+    _lastFrame = timestamp;
+
+    if (last != 0 && timestamp > last)
+    {
+        auto measured = timerToNanoseconds(timestamp - last) / 1000;
+        auto reportedMilliseconds = reportedFrameTime(desc);
+
+        if (measured > FrameStatsPauseMilliseconds * 1000ull)
+        {
+            _pauses.fetch_add(1, std::memory_order_relaxed);
+            resetDriftWindow();
+        }
+        else
+        {
+            recordSeries(_measured, measured);
+
+            // Also false for NaN
+            if (reportedMilliseconds > 0.0f && reportedMilliseconds < (float)FrameStatsPauseMilliseconds)
+            {
+                auto reported = (uint64_t)(reportedMilliseconds * 1000.0f + 0.5f);
+                recordSeries(_reported, reported);
+                updateDrift(measured, reported);
+            }
+        }
+    }
+
+    _recording.clear(std::memory_order_release);
+}
+
+static void resetSeries(FrameSeries& series)
+{
+    series.histogram.reset();
+    series.stutters.store(0, std::memory_order_relaxed);
+    series.worstStutter.store(0, std::memory_order_relaxed);
+    series.average = 0.0;
+}
+
+void resetFrameStats()
+{
+    // Holding the flag like a recording thread, frames meanwhile are counted as concurrent
+    while (_recording.test_and_set(std::memory_order_acquire))
+        std::this_thread::yield();
+
+    resetSeries(_measured);
+    resetSeries(_reported);
+    resetDriftWindow();
+    _lastFrame = 0;
+
+    _frames.store(0, std::memory_order_relaxed);
+    _pauses.store(0, std::memory_order_relaxed);
+    _concurrent.store(0, std::memory_order_relaxed);
+    _windows.store(0, std::memory_order_relaxed);
+    _driftWindows.store(0, std::memory_order_relaxed);
+    _worstDrift.store(0, std::memory_order_relaxed);
+
+    _recording.clear(std::memory_order_release);
+}
+
+// Frame rate with one decimal from a frame time in microseconds
+static void appendRate(FormatBuffer& out, uint64_t micros)
+{
+    auto tenths = micros > 0 ? 10000000 / micros : 0;
+    out.appendNumber(tenths / 10).append('.').appendNumber(tenths % 10).append(" fps");
+}
+
+static void appendMillis(FormatBuffer& out, uint64_t micros)
+{
+    out.appendNumber(micros / 1000).append('.').appendNumber((micros / 100) % 10).append(" ms");
+}
+
+static void appendPercent(FormatBuffer& out, int64_t hundredths)
+{
+    auto size = hundredths < 0 ? -hundredths : hundredths;
+    out.append(hundredths < 0 ? '-' : '+').appendNumber(size / 100).append('.').appendNumber(size / 10 % 10).appendNumber(size % 10).append('%');
+}
+
+// 1% low is the rate at the frame time only 1% of the frames exceed, 0.1% low likewise
+static void reportSeries(FormatBuffer& out, std::string_view time, const char* name, const FrameSeries& series)
+{
+    auto& histogram = series.histogram;
+
+    if (histogram.count() == 0)
+        return;
+
+    out.append('[').append(time).append("] frames ").append(name).append(": avg ");
+    appendRate(out, histogram.sum() / histogram.count());
+    out.append(", 1% low ");
+    appendRate(out, histogram.percentile(0.99));
+    out.append(", 0.1% low ");
+    appendRate(out, histogram.percentile(0.999));
+    out.append(", ").appendNumber(series.stutters.load(std::memory_order_relaxed)).append(" stutters");
+
+    if (auto worst = series.worstStutter.load(std::memory_order_relaxed))
+    {
+        out.append(", worst ");
+        appendMillis(out, worst);
+    }
+
+    out.append('\n');
+}
+
+void reportFrameStats(FormatBuffer& out, std::string_view time)
+{
+    auto frames = _frames.load(std::memory_order_relaxed);
+
+    if (frames == 0)
+        return;
+
+    out.append('[').append(time).append("] frames: ").appendNumber(frames).append(" frames, ").appendNumber(_pauses.load(std::memory_order_relaxed)).append(" pauses");
+
+    if (auto concurrent = _concurrent.load(std::memory_order_relaxed))
+        out.append(", ").appendNumber(concurrent).append(" from concurrent threads not timed");
+
+    out.append('\n');
+
+    reportSeries(out, time, "measured", _measured);
+    reportSeries(out, time, "reported", _reported);
+
+    auto windows = _windows.load(std::memory_order_relaxed);
+
+    if (windows > 0)
+    {
+        out.append('[').append(time).append("] frames drift: ").appendNumber(_driftWindows.load(std::memory_order_relaxed)).append(" of ").appendNumber(windows);
+        out.append(" windows of reported time off measured by more than ").appendNumber(FrameStatsDriftPercent).append("%, worst ");
+        appendPercent(out, _worstDrift.load(std::memory_order_relaxed));
+        out.append('\n');
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include "ffx_api.h"
+#include "format_buffer.h"
+
+// Gaps longer than this are pauses (loading, alt-tab) rather than frames and are left out
+constexpr uint32_t FrameStatsPauseMilliseconds = 1000;
+
+// Reported and measured frame time are compared over windows of this many frames, a window
+// drifts when the two differ by more than FrameStatsDriftPercent
+constexpr uint32_t FrameStatsDriftWindow = 120;
+constexpr uint32_t FrameStatsDriftPercent = 5;
+
+// A frame stutters when it takes this many hundredths of the recent average frame time
+constexpr uint32_t FrameStatsStutterPercent = 250;
+
+// A frame is an upscale dispatch, or a frame generation prepare dispatch for apps that don't upscale
+bool isFrameDispatch(uint64_t type);
+
+// Called after every successful dispatch, measures the time between frames and takes the
+// frameTimeDelta the app reported for them. Constant memory, a frame recorded while another
+// thread records one is only counted.
+void recordFrame(const ffxApiHeader* desc, uint64_t timestamp);
+
+// Average and 1%/0.1% low frame rate of the measured and the reported frame times, stutters
+// and drift between the two since the proxy was loaded or the last reset. Safe to call at any time.
+void reportFrameStats(FormatBuffer& out, std::string_view time);
+
+// Starts the statistics over from the next frame, waits for a frame being recorded
+void resetFrameStats();
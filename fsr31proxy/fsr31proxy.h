@@ -0,0 +1,43 @@
+#pragma once
+// fsr31proxy: controls the proxy exports besides the five ffx-api entry points, tools and
+// benchmarks get them with GetProcAddress/dlsym
+#include <stdint.h>
+#include "ffx_export.h"
+#include "ffx_api.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Loads another provider and swaps it in for the current one once no context created through
+// the current one is alive, right away if none is. Calls in flight finish on the old provider,
+// the log and trace get a marker before and after the swap. Returns FFX_API_RETURN_ERROR when
+// the library can't be loaded or lacks an ffx-api entry point. Not from a provider callback.
+FFX_API_ENTRY ffxReturnCode_t fsr31proxySwapProvider(const char* fileName);
+typedef ffxReturnCode_t (*PfnFsr31proxySwapProvider)(const char* fileName);
+
+// Stops the config watcher and the capture writer, joining their threads, and writes the final
+// reports. For hosts that want the log complete before they exit, the proxy itself stays
+// loaded until process exit. Calls are still forwarded afterwards, they are no longer captured
+// and the file is no longer watched. Not from DllMain or a provider callback.
+FFX_API_ENTRY void fsr31proxyShutdown();
+typedef void (*PfnFsr31proxyShutdown)();
+
+// Keys of the ffx key-value configure descriptors the proxy acts on itself and never forwards:
+// ffxConfigureDescUpscaleKeyValue, ffxConfigureDescFrameGenerationKeyValue and the DX12 and
+// Vulkan swap chain ones, as the first descriptor of an ffxConfigure on any context. Test
+// harnesses control the proxy through the configure path the engine already calls. Unknown
+// keys in the range, values out of range and a proxy key with a pNext chain return
+// FFX_API_RETURN_ERROR_PARAMETER, send each key in an ffxConfigure of its own.
+#define FSR31PROXY_KEY_MASK                 0xffffffff00000000ull
+#define FSR31PROXY_KEY_BASE                 0x4653523300000000ull   // "FSR3"
+
+#define FSR31PROXY_KEY_CAPTURE              (FSR31PROXY_KEY_BASE + 1)   // u64 1 records calls, 0 stops recording them, log messages are kept
+#define FSR31PROXY_KEY_FLUSH                (FSR31PROXY_KEY_BASE + 2)   // writes everything captured so far and the reports, FFX_API_RETURN_ERROR if that takes over a second
+#define FSR31PROXY_KEY_RESET_STATISTICS     (FSR31PROXY_KEY_BASE + 3)   // latency, proxy overhead and frame statistics start over
+#define FSR31PROXY_KEY_SAMPLING             (FSR31PROXY_KEY_BASE + 4)   // u64 0 all dispatches, 1 every interval-th, 2 only the ones with reset
+#define FSR31PROXY_KEY_SAMPLE_INTERVAL      (FSR31PROXY_KEY_BASE + 5)   // u64 interval of sampling 1, at least 1
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear histogram in the HDR histogram style: values below 2^(SubBucketBits + 1) get a
+// bucket each, above that every power of two is split into 2^SubBucketBits buckets, so any
+// recorded value is reported within 1 / 2^SubBucketBits of itself. Fixed memory, recording is
+// a few bit operations and one relaxed increment and is safe from any thread.
+template <uint32_t SubBucketBits, uint32_t MaxValueBits>
+class Histogram
+{
+    static_assert(SubBucketBits > 0 && MaxValueBits > SubBucketBits + 1 && MaxValueBits <= 63);
+
+public:
+    static constexpr uint32_t SubBuckets = 1u << SubBucketBits;
+    static constexpr uint32_t LinearBuckets = SubBuckets * 2;
+    static constexpr uint32_t BucketCount = LinearBuckets + (MaxValueBits - SubBucketBits - 1) * SubBuckets;
+    static constexpr uint64_t MaxValue = (1ull << MaxValueBits) - 1;
+
+    Histogram() = default;
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    // Larger values are clamped to MaxValue
+    void record(uint64_t value)
+    {
+        if (value > MaxValue)
+            value = MaxValue;
+
+        _counts[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(value, std::memory_order_relaxed);
+
+        auto max = _max.load(std::memory_order_relaxed);
+        while (value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Starts over, values recorded meanwhile may be partly kept
+    void reset()
+    {
+        for (auto& count : _counts)
+            count.store(0, std::memory_order_relaxed);
+
+        _count.store(0, std::memory_order_relaxed);
+        _max.store(0, std::memory_order_relaxed);
+        _sum.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+    uint64_t max() const { return _max.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return _sum.load(std::memory_order_relaxed); }
+
+    // Highest value of the bucket holding the given fraction of the recorded values, 0 if empty
+    uint64_t percentile(double fraction) const
+    {
+        uint64_t total = 0;
+
+        for (uint32_t i = 0; i < BucketCount; i++)
+            total += _counts[i].load(std::memory_order_relaxed);
+
+        if (total == 0)
+            return 0;
+
+        auto target = (uint64_t)(fraction * (double)total + 0.5);
+        if (target < 1)
+            target = 1;
+
+        uint64_t seen = 0;
+
+        for (uint32_t i = 0; i < BucketCount; i++)
+        {
+            seen += _counts[i].load(std::memory_order_relaxed);
+
+            if (seen >= target)
+            {
+                auto value = bucketHighest(i);
+                auto max = _max.load(std::memory_order_relaxed);
+                return value < max ? value : max;
+            }
+        }
+
+        return _max.load(std::memory_order_relaxed);
+    }
+
+    static constexpr uint32_t bucketIndex(uint64_t value)
+    {
+        if (value < LinearBuckets)
+            return (uint32_t)value;
+
+        auto exponent = (uint32_t)std::bit_width(value) - 1;
+        auto shift = exponent - SubBucketBits;
+        return LinearBuckets + (exponent - SubBucketBits - 1) * SubBuckets + (uint32_t)((value >> shift) - SubBuckets);
+    }
+
+    static constexpr uint64_t bucketHighest(uint32_t index)
+    {
+        if (index < LinearBuckets)
+            return index;
+
+        auto exponent = (index - LinearBuckets) / SubBuckets + SubBucketBits + 1;
+        auto sub = (uint64_t)((index - LinearBuckets) % SubBuckets + SubBuckets);
+        auto shift = exponent - SubBucketBits;
+        return ((sub + 1) << shift) - 1;
+    }
+
+private:
+    std::atomic<uint32_t> _counts[BucketCount] = {};
+    std::atomic<uint64_t> _count{ 0 };
+    std::atomic<uint64_t> _max{ 0 };
+    std::atomic<uint64_t> _sum{ 0 };
+};
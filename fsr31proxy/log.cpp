@@ -1,42 +1,69 @@
 #include "pch.h"
 #include "log.h"
-#include <fstream>
-#include <format>
-
-std::ostream null(nullptr);
-std::ostream* logStream = &null;
-std::ofstream fileStream;
-
-std::string getCurrentTimeFormatted() {
-    auto now = std::chrono::system_clock::now();
-    auto now_t = std::chrono::system_clock::to_time_t(now);
-    auto now_tm = *std::localtime(&now_t);
-    auto now_duration = now - std::chrono::system_clock::from_time_t(std::mktime(&now_tm));
-    auto now_us = std::chrono::duration_cast<std::chrono::microseconds>(now_duration);
-    std::ostringstream oss;
-    oss << std::setfill('0') << std::setw(2) << now_tm.tm_hour << ":"
-        << std::setfill('0') << std::setw(2) << now_tm.tm_min << ":"
-        << std::setfill('0') << std::setw(2) << now_tm.tm_sec << "."
-        << std::setfill('0') << std::setw(6) << now_us.count();
-
-    return oss.str();
+#include "capture.h"
+#include "file_sink.h"
+#include "timer.h"
+#include <cstring>
+
+// Both sinks keep at most SegmentCount segments of SegmentSize bytes on disk
+constexpr size_t SegmentSize = 64 * 1024 * 1024;
+constexpr uint32_t SegmentCount = 4;
+
+FileSink logFile;
+FileSink traceFile;
+
+static uint32_t levelBits(LogLevel level) {
+    uint32_t bits = 0;
+    for (uint32_t i = (uint32_t)LogLevel::Error; i <= (uint32_t)level && i <= (uint32_t)LogCompiledLevel; i++)
+        bits |= logLevelBit((LogLevel)i);
+
+    return bits;
 }
 
-void log(const std::string& log) {
-    *logStream << "[" << getCurrentTimeFormatted() << "] " << log << std::endl;
+std::atomic<uint32_t> logMask = levelBits(LogCompiledLevel) | LogCategoryAll;
+
+void setLogLevel(LogLevel level) {
+    logMask.store(levelBits(level) | (logMask.load() & LogCategoryAll));
+}
+
+void setLogCategories(uint32_t categories) {
+    logMask.store((logMask.load() & ~(uint32_t)LogCategoryAll) | (categories & LogCategoryAll));
 }
 
-void prepareLogging(std::string fileName) {
-    fileStream.open(fileName, std::ios_base::out | std::ios_base::app);
-    if (fileStream.is_open()) {
-        logStream = &fileStream;
-        return;
+void log(LogLevel level, uint32_t categories, const std::string& log) {
+    if (logEnabled(level, categories))
+        captureMessage(log.data(), log.size());
+}
+
+void log(LogLevel level, uint32_t categories, const char* text, size_t size) {
+    if (logEnabled(level, categories))
+        captureMessage(text, strnlen(text, size));
+}
+
+void prepareLogging(std::string fileName, std::string traceFileName) {
+    timerCalibrate();
+
+    if (!fileName.empty()) {
+        if (!logFile.open(fileName, SegmentSize, SegmentCount)) {
+            std::cerr << "Failed to open log file: " << fileName << std::endl;
+        }
     }
-    else {
-        std::cerr << "Failed to open log file: " << fileName << std::endl;
+
+    if (!traceFileName.empty()) {
+        if (!traceFile.open(traceFileName, SegmentSize, SegmentCount)) {
+            std::cerr << "Failed to open trace file: " << traceFileName << std::endl;
+        }
     }
+
+    startCapture(logFile.isOpen() ? &logFile : nullptr, traceFile.isOpen() ? &traceFile : nullptr);
 }
 
-void closeLogging() {
-    fileStream.close();
+void closeLogging(bool processExit) {
+    if (processExit)
+        abandonCapture();
+    else
+        stopCapture();
+
+    logFile.close();
+    traceFile.close();
 }
\ No newline at end of file
@@ -1,11 +1,77 @@
 #pragma once
 #include <iostream>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <string>
 #include <source_location>
 
-std::string getCurrentTimeFormatted();
-void log(const std::string& log);
-void prepareLogging(std::string fileName);
-void closeLogging();
\ No newline at end of file
+enum class LogLevel : uint32_t
+{
+    Off,
+    Error,
+    Warning,
+    Info,
+    Verbose,
+};
+
+// Entry point and effect categories, a call needs both of its bits enabled
+enum LogCategory : uint32_t
+{
+    LogCategoryGeneral          = 1 << 0,
+    LogCategoryCreate           = 1 << 1,
+    LogCategoryDestroy          = 1 << 2,
+    LogCategoryConfigure        = 1 << 3,
+    LogCategoryQuery            = 1 << 4,
+    LogCategoryDispatch         = 1 << 5,
+    LogCategoryGlobal           = 1 << 8,   // Descriptors without an effect: backends, versions, debug
+    LogCategoryUpscale          = 1 << 9,
+    LogCategoryFrameGeneration  = 1 << 10,
+    LogCategorySwapChain        = 1 << 11,
+    LogCategoryAll              = 0x00ffffff,
+};
+
+// Levels above FSR31PROXY_LOG_LEVEL are compiled out, build with
+// FSR31PROXY_LOG_LEVEL=1 for an errors only proxy
+#ifndef FSR31PROXY_LOG_LEVEL
+#define FSR31PROXY_LOG_LEVEL 4
+#endif
+
+constexpr LogLevel LogCompiledLevel = (LogLevel)FSR31PROXY_LOG_LEVEL;
+
+// Low 24 bits are categories, the bits above are the enabled levels
+extern std::atomic<uint32_t> logMask;
+
+constexpr uint32_t logLevelBit(LogLevel level)
+{
+    return 1u << (23 + (uint32_t)level);
+}
+
+inline bool logEnabled(LogLevel level, uint32_t categories)
+{
+    if (level > LogCompiledLevel || level == LogLevel::Off)
+        return false;
+
+    auto required = logLevelBit(level) | categories;
+    return (logMask.load(std::memory_order_relaxed) & required) == required;
+}
+
+template <LogLevel Level>
+inline bool logEnabled(uint32_t categories)
+{
+    if constexpr (Level > LogCompiledLevel || Level == LogLevel::Off)
+        return false;
+    else
+        return logEnabled(Level, categories);
+}
+
+void setLogLevel(LogLevel level);
+void setLogCategories(uint32_t categories);
+
+void log(LogLevel level, uint32_t categories, const std::string& log);
+// For messages formatted into a fixed buffer of size bytes, e.g. by snprintf, which cut them
+// at the terminator. Logs up to it without building a std::string on the game thread.
+void log(LogLevel level, uint32_t categories, const char* text, size_t size);
+void prepareLogging(std::string fileName, std::string traceFileName = "");
+// At process exit the capture writer was already killed, what is left is written on the calling thread
+void closeLogging(bool processExit = false);
\ No newline at end of file
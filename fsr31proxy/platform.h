@@ -0,0 +1,197 @@
+#pragma once
+// The parts that differ between the Windows proxy and POSIX builds, which run the proxy
+// headless against fsr31mock
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "ffx_export.h"
+
+#ifdef _WIN32
+using LibraryHandle = HMODULE;
+#else
+using LibraryHandle = void*;
+#endif
+
+// Provider the proxy forwards to unless file in the [provider] section of fsr31proxy.ini names another one
+#ifdef _WIN32
+constexpr const char* DefaultProviderName = "amd_fidelityfx_dx12.o.dll";
+#else
+constexpr const char* DefaultProviderName = "libfsr31mock.so";
+#endif
+
+inline LibraryHandle loadLibrary(const char* fileName)
+{
+#ifdef _WIN32
+    return LoadLibraryA(fileName);
+#else
+    return dlopen(fileName, RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+inline void* librarySymbol(LibraryHandle library, const char* name)
+{
+#ifdef _WIN32
+    return (void*)GetProcAddress(library, name);
+#else
+    return dlsym(library, name);
+#endif
+}
+
+// The provider's entry points are looked up with the SDK's loader helper, which needs windows.h.
+// Other platforms get the same table filled through dlsym.
+#ifdef _WIN32
+#include "ffx_api_loader.h"
+#else
+#include "ffx_api.h"
+
+typedef struct ffxFunctions {
+    PfnFfxCreateContext CreateContext;
+    PfnFfxDestroyContext DestroyContext;
+    PfnFfxConfigure Configure;
+    PfnFfxQuery Query;
+    PfnFfxDispatch Dispatch;
+} ffxFunctions;
+
+static inline void ffxLoadFunctions(ffxFunctions* pOutFunctions, LibraryHandle module)
+{
+    pOutFunctions->CreateContext  = (PfnFfxCreateContext )librarySymbol(module, "ffxCreateContext");
+    pOutFunctions->DestroyContext = (PfnFfxDestroyContext)librarySymbol(module, "ffxDestroyContext");
+    pOutFunctions->Configure      = (PfnFfxConfigure     )librarySymbol(module, "ffxConfigure");
+    pOutFunctions->Query          = (PfnFfxQuery         )librarySymbol(module, "ffxQuery");
+    pOutFunctions->Dispatch       = (PfnFfxDispatch      )librarySymbol(module, "ffxDispatch");
+}
+#endif
+
+inline void freeLibrary(LibraryHandle library)
+{
+#ifdef _WIN32
+    FreeLibrary(library);
+#else
+    dlclose(library);
+#endif
+}
+
+// Full path of a loaded library, symbol is any address inside it for dladdr. Returns false
+// with an empty path when it can't be found or library is null, which GetModuleFileName
+// would take for the game's exe.
+inline bool libraryPath(LibraryHandle library, const void* symbol, char* path, size_t size)
+{
+    path[0] = 0;
+
+    if (library == nullptr)
+        return false;
+
+#ifdef _WIN32
+    (void)symbol;
+    auto length = GetModuleFileNameA(library, path, (DWORD)size);
+    return length > 0 && length < size;
+#else
+    Dl_info info;
+
+    if (dladdr(symbol, &info) == 0 || info.dli_fname == nullptr || strlen(info.dli_fname) >= size)
+        return false;
+
+    memcpy(path, info.dli_fname, strlen(info.dli_fname) + 1);
+    return true;
+#endif
+}
+
+// Full path of the module holding address, e.g. the proxy itself. Returns false with an empty
+// path when it isn't in one.
+inline bool modulePath(const void* address, char* path, size_t size)
+{
+    path[0] = 0;
+
+#ifdef _WIN32
+    HMODULE module = nullptr;
+
+    if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCSTR)address, &module))
+        return false;
+
+    return libraryPath(module, address, path, size);
+#else
+    Dl_info info;
+
+    if (dladdr(address, &info) == 0 || info.dli_fname == nullptr || strlen(info.dli_fname) >= size)
+        return false;
+
+    memcpy(path, info.dli_fname, strlen(info.dli_fname) + 1);
+    return true;
+#endif
+}
+
+// Keeps the module holding address loaded until the process exits. The proxy's threads can't
+// outlive its code then, and it is only ever unloaded at process exit.
+inline void pinLibrary(const void* address)
+{
+#ifdef _WIN32
+    HMODULE module = nullptr;
+    GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_PIN, (LPCSTR)address, &module);
+#else
+    Dl_info info;
+
+    if (dladdr(address, &info) != 0 && info.dli_fname != nullptr)
+        dlopen(info.dli_fname, RTLD_NOW | RTLD_NOLOAD | RTLD_NODELETE);
+#endif
+}
+
+// Return address of the function it is used in, i.e. the call site in the caller
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CALLER_ADDRESS() _ReturnAddress()
+#else
+#define CALLER_ADDRESS() __builtin_return_address(0)
+#endif
+
+// File name of the module holding address, without its directory. Returns the offset of
+// address in the module, 0 with an empty name when it isn't in one. Not for the hot path.
+inline uintptr_t moduleOffset(const void* address, char* name, size_t size)
+{
+    name[0] = 0;
+    const char* path = nullptr;
+    uintptr_t base = 0;
+
+#ifdef _WIN32
+    HMODULE module = nullptr;
+    char buffer[MAX_PATH];
+
+    if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCSTR)address, &module) &&
+        GetModuleFileNameA(module, buffer, sizeof(buffer)) > 0)
+    {
+        path = buffer;
+        base = (uintptr_t)module;
+    }
+#else
+    Dl_info info;
+
+    if (dladdr(address, &info) != 0 && info.dli_fname != nullptr)
+    {
+        path = info.dli_fname;
+        base = (uintptr_t)info.dli_fbase;
+    }
+#endif
+
+    if (path == nullptr)
+        return 0;
+
+    auto fileName = path;
+
+    for (auto c = path; *c != 0; c++)
+    {
+        if (*c == '/' || *c == '\\')
+            fileName = c + 1;
+    }
+
+    auto length = strlen(fileName) < size - 1 ? strlen(fileName) : size - 1;
+    memcpy(name, fileName, length);
+    name[length] = 0;
+    return (uintptr_t)address - base;
+}
@@ -0,0 +1,284 @@
+#include "pch.h"
+#include "provider.h"
+#include "context_registry.h"
+#include "log.h"
+#include "query_cache.h"
+#include "timer.h"
+#include "version_cache.h"
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Calls in flight per epoch parity, a swap waits for the parity it left to drain
+struct alignas(64) ProviderReaders
+{
+    std::atomic<uint64_t> count{ 0 };
+};
+
+static ProviderReaders _readers[2];
+static std::atomic<uint64_t> _epoch{ 0 };
+static std::atomic<ProviderTable*> _current{ nullptr };
+static std::atomic<ProviderTable*> _pending{ nullptr };
+
+// Serializes swaps, never taken by a forwarded call
+static std::mutex _swapLock;
+static uint32_t _generation = 0;
+static uint64_t _swaps = 0;
+
+// Replaced tables with contexts still alive on them, unloaded after their last destroy
+static std::vector<ProviderTable*> _retired;
+static std::atomic<uint32_t> _retiredCount{ 0 };
+
+ProviderCall::ProviderCall(const ContextInfo* context)
+{
+    // Counting before loading the table, a swap that misses the count has already published
+    // the new one and a retired table is only freed after its last context's destroy
+    _parity = (uint32_t)(_epoch.load(std::memory_order_seq_cst) & 1);
+    _readers[_parity].count.fetch_add(1, std::memory_order_seq_cst);
+    _pinned = true;
+
+    _table = context != nullptr ? context->provider : nullptr;
+
+    if (_table == nullptr)
+        _table = _current.load(std::memory_order_seq_cst);
+}
+
+void ProviderCall::leave()
+{
+    if (!_pinned)
+        return;
+
+    _readers[_parity].count.fetch_sub(1, std::memory_order_release);
+    _pinned = false;
+    _table = nullptr;
+}
+
+void addProviderContext(ProviderTable* table)
+{
+    if (table != nullptr)
+        table->contexts.fetch_add(1, std::memory_order_relaxed);
+}
+
+void removeProviderContext(ProviderTable* table)
+{
+    if (table == nullptr)
+        return;
+
+    auto count = table->contexts.load(std::memory_order_relaxed);
+
+    while (count > 0 && !table->contexts.compare_exchange_weak(count, count - 1, std::memory_order_release))
+    {
+    }
+}
+
+// Each flip moves new calls to the other parity and waits for the one left behind. A call
+// that read the epoch before the first flip is counted in one of the two parities.
+static void waitForCalls()
+{
+    for (int i = 0; i < 2; i++)
+    {
+        auto parity = _epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+
+        while (_readers[parity].count.load(std::memory_order_acquire) != 0)
+            std::this_thread::yield();
+    }
+}
+
+static ProviderTable* loadTable(const char* fileName)
+{
+    auto table = new ProviderTable();
+    table->library = loadLibrary(fileName);
+
+    if (table->library != nullptr)
+        ffxLoadFunctions(&table->functions, table->library);
+
+    if (table->library == nullptr || !libraryPath(table->library, (const void*)table->functions.Query, table->path, sizeof(table->path)))
+    {
+        auto length = strlen(fileName) < sizeof(table->path) - 1 ? strlen(fileName) : sizeof(table->path) - 1;
+        memcpy(table->path, fileName, length);
+        table->path[length] = 0;
+    }
+
+    return table;
+}
+
+static bool complete(const ProviderTable* table)
+{
+    auto& functions = table->functions;
+
+    return table->library != nullptr && functions.CreateContext != nullptr && functions.DestroyContext != nullptr &&
+        functions.Configure != nullptr && functions.Query != nullptr && functions.Dispatch != nullptr;
+}
+
+static void freeTable(ProviderTable* table)
+{
+    if (table->library != nullptr)
+        freeLibrary(table->library);
+
+    delete table;
+}
+
+void openProvider(const char* fileName)
+{
+    auto table = loadTable(fileName);
+
+    _current.store(table, std::memory_order_seq_cst);
+    openVersionCache(table->library != nullptr ? table->path : "");
+}
+
+static void logText(LogLevel level, const char* text, int length, size_t size)
+{
+    if (length > 0)
+        log(level, LogCategoryGeneral, text, size);
+}
+
+// Needs _swapLock. The markers split the trace into the calls of the two providers.
+static void swapWhenIdleLocked()
+{
+    auto previous = _current.load(std::memory_order_relaxed);
+
+    if (previous == nullptr || previous->contexts.load(std::memory_order_acquire) != 0)
+        return;
+
+    auto next = _pending.exchange(nullptr, std::memory_order_acq_rel);
+
+    if (next == nullptr)
+        return;
+
+    char text[2200];
+    auto start = timerNow();
+    auto length = snprintf(text, sizeof(text), "provider swap %u begin: %s -> %s, %.3f ms after the request", next->generation, previous->path, next->path,
+        timerToMilliseconds(start - next->requested));
+    logText(LogLevel::Info, text, length, sizeof(text));
+
+    _current.store(next, std::memory_order_seq_cst);
+    waitForCalls();
+
+    // Answers of the old provider for calls without a context, the others died with their contexts
+    forgetQueries(nullptr);
+    openVersionCache(next->path);
+    _swaps++;
+
+    // A create that raced with the swap left a context on the old provider, it stays loaded
+    // and serves that context until its destroy
+    if (previous->contexts.load(std::memory_order_acquire) != 0)
+    {
+        _retired.push_back(previous);
+        _retiredCount.store((uint32_t)_retired.size(), std::memory_order_release);
+        length = snprintf(text, sizeof(text), "provider swap %u: a context was created on %s during the swap, it stays loaded until destroyed", next->generation, previous->path);
+        logText(LogLevel::Warning, text, length, sizeof(text));
+    }
+    else
+    {
+        freeTable(previous);
+    }
+
+    length = snprintf(text, sizeof(text), "provider swap %u end: %s, calls in flight drained in %.3f ms", next->generation, next->path, timerToMilliseconds(timerNow() - start));
+    logText(LogLevel::Info, text, length, sizeof(text));
+}
+
+// Needs _swapLock. One wait covers every table whose last context is gone.
+static void freeRetiredLocked()
+{
+    std::vector<ProviderTable*> idle;
+
+    for (size_t i = 0; i < _retired.size();)
+    {
+        if (_retired[i]->contexts.load(std::memory_order_acquire) == 0)
+        {
+            idle.push_back(_retired[i]);
+            _retired.erase(_retired.begin() + (ptrdiff_t)i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    if (idle.empty())
+        return;
+
+    _retiredCount.store((uint32_t)_retired.size(), std::memory_order_release);
+    waitForCalls();
+
+    for (auto table : idle)
+    {
+        log(LogLevel::Info, LogCategoryGeneral, std::string("provider: last context of ") + table->path + " destroyed, unloaded");
+        freeTable(table);
+    }
+}
+
+bool requestProviderSwap(const char* fileName)
+{
+    if (fileName == nullptr || fileName[0] == 0)
+        return false;
+
+    // Loaded outside of the lock, a provider's own startup can take a while
+    auto table = loadTable(fileName);
+
+    if (!complete(table))
+    {
+        log(LogLevel::Error, LogCategoryGeneral, std::string("provider swap: can't load ") + fileName);
+        freeTable(table);
+        return false;
+    }
+
+    std::lock_guard lock(_swapLock);
+
+    table->generation = ++_generation;
+    table->requested = timerNow();
+
+    if (auto replaced = _pending.exchange(table, std::memory_order_acq_rel))
+        freeTable(replaced);
+
+    swapWhenIdleLocked();
+    return true;
+}
+
+void swapProviderWhenIdle()
+{
+    if (_pending.load(std::memory_order_relaxed) == nullptr && _retiredCount.load(std::memory_order_relaxed) == 0)
+        return;
+
+    std::lock_guard lock(_swapLock);
+    freeRetiredLocked();
+    swapWhenIdleLocked();
+}
+
+void closeProvider()
+{
+    std::lock_guard lock(_swapLock);
+
+    if (auto pending = _pending.exchange(nullptr, std::memory_order_acq_rel))
+        freeTable(pending);
+
+    for (auto table : _retired)
+        freeTable(table);
+
+    _retired.clear();
+    _retiredCount.store(0, std::memory_order_release);
+
+    if (auto current = _current.exchange(nullptr, std::memory_order_acq_rel))
+        freeTable(current);
+}
+
+void reportProvider(FormatBuffer& out, std::string_view time)
+{
+    std::lock_guard lock(_swapLock);
+
+    auto current = _current.load(std::memory_order_relaxed);
+
+    if (current == nullptr || (_swaps == 0 && _pending.load(std::memory_order_relaxed) == nullptr))
+        return;
+
+    out.append('[').append(time).append("] provider: ").append(current->path).append(", ").appendNumber(_swaps).append(" swaps");
+
+    for (auto table : _retired)
+        out.append(", ").append(table->path).append(" kept loaded for ").appendNumber((uint64_t)table->contexts.load(std::memory_order_relaxed)).append(" contexts");
+
+    if (auto pending = _pending.load(std::memory_order_relaxed))
+        out.append(", ").append(pending->path).append(" waiting for ").appendNumber((uint64_t)current->contexts.load(std::memory_order_relaxed)).append(" contexts");
+
+    out.append('\n');
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include "ffx_api.h"
+#include "format_buffer.h"
+#include "platform.h"
+
+struct ContextInfo;
+
+// The loaded original dll. Tables are published through an atomic pointer, calls pin the
+// current one or the one their context was created through for the duration of the forwarded
+// call. A replaced table is freed once none of its contexts is alive and every call that could
+// have seen it has returned.
+struct ProviderTable
+{
+    LibraryHandle library = nullptr;
+    ffxFunctions functions = {};
+    std::atomic<int64_t> contexts{ 0 };     // created and not yet destroyed through this table
+    uint32_t generation = 0;                // 0 for the provider loaded at startup
+    uint64_t requested = 0;                 // timestamp of the swap request
+    char path[1024] = {};
+};
+
+// Pins a provider table from construction to leave(). Two atomic adds on a shared counter,
+// swaps never block a call.
+class ProviderCall
+{
+public:
+    // Calls of a tracked context go to the provider that created it, everything else to the
+    // current one. A swapped out provider keeps serving its contexts until they are destroyed.
+    explicit ProviderCall(const ContextInfo* context = nullptr);
+    ~ProviderCall() { leave(); }
+
+    ProviderCall(const ProviderCall&) = delete;
+    ProviderCall& operator=(const ProviderCall&) = delete;
+
+    const ffxFunctions* operator->() const { return &_table->functions; }
+    ProviderTable* table() const { return _table; }
+
+    // The table may be freed after this, counts on it have to come first
+    void leave();
+
+private:
+    ProviderTable* _table;
+    uint32_t _parity;
+    bool _pinned;
+};
+
+// Context counts of a table, after a successful create and destroy through it. A destroy of a
+// context the registry couldn't track is taken off the current table, never below 0.
+void addProviderContext(ProviderTable* table);
+void removeProviderContext(ProviderTable* table);
+
+// Loads the provider at startup. A library that fails to load leaves a table without
+// functions, calls fail as they did before.
+void openProvider(const char* fileName);
+
+// Loads fileName right away and swaps it in at the next safe point, when no context created
+// through the current provider is alive: immediately if none is, otherwise after the
+// ffxDestroyContext of the last one. A newer request replaces one still waiting. Returns
+// false when the library can't be loaded or lacks an entry point.
+bool requestProviderSwap(const char* fileName);
+
+// Called after every ffxDestroyContext outside of any ProviderCall, swaps in a waiting
+// provider once the current one has no contexts and unloads replaced ones whose last context
+// is gone. Only two atomic loads when there is nothing to do.
+void swapProviderWhenIdle();
+
+// At unload, no call may be in flight
+void closeProvider();
+
+// Current provider, swaps done, replaced ones still in use and a waiting one
+void reportProvider(FormatBuffer& out, std::string_view time);
@@ -0,0 +1,316 @@
+#include "pch.h"
+#include "query_cache.h"
+#include "log.h"
+#include "ffx_upscale.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+// Mismatches logged in verify mode, later ones are only counted
+constexpr uint32_t QueryCacheLoggedMismatches = 8;
+
+// Inputs of a query packed next to its type, at most three 32-bit ones
+struct QueryKey
+{
+    uint64_t context;
+    uint64_t typeInput;     // type << 32 | third input, never 0
+    uint64_t inputs;        // first input << 32 | second input
+};
+
+// A seqlock per slot, the version is odd while a writer owns it. Writers that find a slot
+// owned skip it, readers that see the version change treat the slot as a miss.
+struct QuerySlot
+{
+    std::atomic<uint32_t> version{ 0 };
+    std::atomic<uint64_t> context{ 0 };
+    std::atomic<uint64_t> typeInput{ 0 };   // 0 while empty
+    std::atomic<uint64_t> inputs{ 0 };
+    std::atomic<uint64_t> outputs{ 0 };     // raw bits of the one or two outputs
+};
+
+static QuerySlot _slots[QueryCacheSlots];
+static std::atomic<uint64_t> _hits{ 0 };
+static std::atomic<uint64_t> _misses{ 0 };
+static std::atomic<uint64_t> _verified{ 0 };
+static std::atomic<uint64_t> _mismatches{ 0 };
+
+static uint64_t pack(uint32_t high, uint32_t low)
+{
+    return (uint64_t)high << 32 | low;
+}
+
+static uint32_t bits(float value)
+{
+    uint32_t result;
+    memcpy(&result, &value, sizeof(result));
+    return result;
+}
+
+// Only unchained queries with all their outputs set, a chained one may carry a version or
+// provider override the answer depends on
+static bool queryKey(ffxContext context, const ffxQueryDescHeader* desc, QueryKey& key)
+{
+    if (desc == nullptr || desc->pNext != nullptr)
+        return false;
+
+    key.context = (uint64_t)(uintptr_t)context;
+
+    switch (desc->type)
+    {
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETUPSCALERATIOFROMQUALITYMODE:
+        {
+            auto query = (const ffxQueryDescUpscaleGetUpscaleRatioFromQualityMode*)desc;
+            key.typeInput = pack((uint32_t)desc->type, 0);
+            key.inputs = query->qualityMode;
+            return query->pOutUpscaleRatio != nullptr;
+        }
+
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETRENDERRESOLUTIONFROMQUALITYMODE:
+        {
+            auto query = (const ffxQueryDescUpscaleGetRenderResolutionFromQualityMode*)desc;
+            key.typeInput = pack((uint32_t)desc->type, query->qualityMode);
+            key.inputs = pack(query->displayWidth, query->displayHeight);
+            return query->pOutRenderWidth != nullptr && query->pOutRenderHeight != nullptr;
+        }
+
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETJITTERPHASECOUNT:
+        {
+            auto query = (const ffxQueryDescUpscaleGetJitterPhaseCount*)desc;
+            key.typeInput = pack((uint32_t)desc->type, 0);
+            key.inputs = pack(query->renderWidth, query->displayWidth);
+            return query->pOutPhaseCount != nullptr;
+        }
+
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETJITTEROFFSET:
+        {
+            auto query = (const ffxQueryDescUpscaleGetJitterOffset*)desc;
+            key.typeInput = pack((uint32_t)desc->type, 0);
+            key.inputs = pack((uint32_t)query->index, (uint32_t)query->phaseCount);
+            return query->pOutX != nullptr && query->pOutY != nullptr;
+        }
+
+        default:
+            return false;
+    }
+}
+
+static uint64_t readOutputs(const ffxQueryDescHeader* desc)
+{
+    switch (desc->type)
+    {
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETUPSCALERATIOFROMQUALITYMODE:
+            return bits(*((const ffxQueryDescUpscaleGetUpscaleRatioFromQualityMode*)desc)->pOutUpscaleRatio);
+
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETRENDERRESOLUTIONFROMQUALITYMODE:
+        {
+            auto query = (const ffxQueryDescUpscaleGetRenderResolutionFromQualityMode*)desc;
+            return pack(*query->pOutRenderWidth, *query->pOutRenderHeight);
+        }
+
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETJITTERPHASECOUNT:
+            return (uint32_t)*((const ffxQueryDescUpscaleGetJitterPhaseCount*)desc)->pOutPhaseCount;
+
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETJITTEROFFSET:
+        {
+            auto query = (const ffxQueryDescUpscaleGetJitterOffset*)desc;
+            return pack(bits(*query->pOutX), bits(*query->pOutY));
+        }
+
+        default:
+            return 0;
+    }
+}
+
+static void writeOutputs(ffxQueryDescHeader* desc, uint64_t outputs)
+{
+    auto high = (uint32_t)(outputs >> 32);
+    auto low = (uint32_t)outputs;
+
+    switch (desc->type)
+    {
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETUPSCALERATIOFROMQUALITYMODE:
+            memcpy(((ffxQueryDescUpscaleGetUpscaleRatioFromQualityMode*)desc)->pOutUpscaleRatio, &low, sizeof(low));
+            break;
+
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETRENDERRESOLUTIONFROMQUALITYMODE:
+        {
+            auto query = (ffxQueryDescUpscaleGetRenderResolutionFromQualityMode*)desc;
+            *query->pOutRenderWidth = high;
+            *query->pOutRenderHeight = low;
+            break;
+        }
+
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETJITTERPHASECOUNT:
+            *((ffxQueryDescUpscaleGetJitterPhaseCount*)desc)->pOutPhaseCount = (int32_t)low;
+            break;
+
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETJITTEROFFSET:
+        {
+            auto query = (ffxQueryDescUpscaleGetJitterOffset*)desc;
+            memcpy(query->pOutX, &high, sizeof(high));
+            memcpy(query->pOutY, &low, sizeof(low));
+            break;
+        }
+    }
+}
+
+static QuerySlot& slotOf(const QueryKey& key)
+{
+    auto hash = (key.context ^ key.typeInput * 0x9e3779b97f4a7c15ull ^ key.inputs * 0xc2b2ae3d27d4eb4full);
+    hash ^= hash >> 29;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    hash ^= hash >> 32;
+    return _slots[hash % QueryCacheSlots];
+}
+
+static bool beginWrite(QuerySlot& slot, uint32_t& version)
+{
+    version = slot.version.load(std::memory_order_relaxed);
+
+    if ((version & 1) != 0 || !slot.version.compare_exchange_strong(version, version + 1, std::memory_order_acquire, std::memory_order_relaxed))
+        return false;
+
+    // The field stores below can't be seen before the odd version
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+}
+
+static void endWrite(QuerySlot& slot, uint32_t version)
+{
+    slot.version.store(version + 2, std::memory_order_release);
+}
+
+// Returns false when a writer owned the slot at any point while it was read
+static bool readSlot(const QuerySlot& slot, QueryKey& key, uint64_t& outputs)
+{
+    auto version = slot.version.load(std::memory_order_acquire);
+
+    if ((version & 1) != 0)
+        return false;
+
+    key.context = slot.context.load(std::memory_order_relaxed);
+    key.typeInput = slot.typeInput.load(std::memory_order_relaxed);
+    key.inputs = slot.inputs.load(std::memory_order_relaxed);
+    outputs = slot.outputs.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.version.load(std::memory_order_relaxed) == version;
+}
+
+static bool sameKey(const QueryKey& a, const QueryKey& b)
+{
+    return a.context == b.context && a.typeInput == b.typeInput && a.inputs == b.inputs;
+}
+
+bool lookupQuery(ffxContext context, ffxQueryDescHeader* desc, QueryCacheMode mode)
+{
+    QueryKey key;
+
+    if (mode == QueryCacheMode::Off || !queryKey(context, desc, key))
+        return false;
+
+    QueryKey cached;
+    uint64_t outputs;
+
+    if (!readSlot(slotOf(key), cached, outputs) || !sameKey(key, cached))
+    {
+        _misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    auto hits = _hits.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    // A sampled hit goes to the provider and storeQuery compares the answers
+    if (mode == QueryCacheMode::Verify && hits % QueryCacheVerifyInterval == 0)
+    {
+        _verified.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    writeOutputs(desc, outputs);
+    return true;
+}
+
+static void logMismatch(const QueryKey& key, uint64_t cached, uint64_t answered)
+{
+    if (!logEnabled<LogLevel::Warning>(LogCategoryQuery))
+        return;
+
+    char text[192];
+    auto length = snprintf(text, sizeof(text), "query cache mismatch: context %llu type 0x%08x inputs 0x%016llx/0x%08x cached 0x%016llx answered 0x%016llx",
+        (unsigned long long)key.context, (uint32_t)(key.typeInput >> 32), (unsigned long long)key.inputs, (uint32_t)key.typeInput,
+        (unsigned long long)cached, (unsigned long long)answered);
+
+    if (length > 0)
+        log(LogLevel::Warning, LogCategoryQuery, text, sizeof(text));
+}
+
+void storeQuery(ffxContext context, const ffxQueryDescHeader* desc, QueryCacheMode mode)
+{
+    QueryKey key;
+
+    if (mode == QueryCacheMode::Off || !queryKey(context, desc, key))
+        return;
+
+    auto answered = readOutputs(desc);
+    auto& slot = slotOf(key);
+
+    QueryKey cached;
+    uint64_t outputs;
+
+    if (readSlot(slot, cached, outputs) && sameKey(key, cached))
+    {
+        if (outputs == answered)
+            return;
+
+        if (_mismatches.fetch_add(1, std::memory_order_relaxed) < QueryCacheLoggedMismatches)
+            logMismatch(key, outputs, answered);
+    }
+
+    // The provider's answer wins over a mismatching cached one
+    uint32_t version;
+
+    if (!beginWrite(slot, version))
+        return;
+
+    slot.context.store(key.context, std::memory_order_relaxed);
+    slot.typeInput.store(key.typeInput, std::memory_order_relaxed);
+    slot.inputs.store(key.inputs, std::memory_order_relaxed);
+    slot.outputs.store(answered, std::memory_order_relaxed);
+    endWrite(slot, version);
+}
+
+void forgetQueries(ffxContext context)
+{
+    auto handle = (uint64_t)(uintptr_t)context;
+
+    for (auto& slot : _slots)
+    {
+        uint32_t version;
+
+        if (slot.context.load(std::memory_order_relaxed) != handle || slot.typeInput.load(std::memory_order_relaxed) == 0 || !beginWrite(slot, version))
+            continue;
+
+        // Checked again now that the slot is owned, it may have been replaced meanwhile
+        if (slot.context.load(std::memory_order_relaxed) == handle)
+            slot.typeInput.store(0, std::memory_order_relaxed);
+
+        endWrite(slot, version);
+    }
+}
+
+void reportQueryCache(FormatBuffer& out, std::string_view time)
+{
+    auto hits = _hits.load(std::memory_order_relaxed);
+    auto misses = _misses.load(std::memory_order_relaxed);
+
+    if (hits == 0 && misses == 0)
+        return;
+
+    out.append('[').append(time).append("] query cache: ").appendNumber(hits).append(" hits, ").appendNumber(misses).append(" misses");
+
+    if (auto verified = _verified.load(std::memory_order_relaxed))
+        out.append(", ").appendNumber(verified).append(" verified, ").appendNumber(_mismatches.load(std::memory_order_relaxed)).append(" mismatched");
+
+    out.append('\n');
+}
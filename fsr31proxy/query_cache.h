@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include "ffx_api.h"
+#include "format_buffer.h"
+
+// Direct mapped, a new answer replaces whatever shared its slot
+constexpr uint32_t QueryCacheSlots = 256;
+
+// Hits forwarded to the provider anyway in verify mode, one in this many
+constexpr uint32_t QueryCacheVerifyInterval = 64;
+
+// Set in the config, read on every query
+enum class QueryCacheMode : uint32_t
+{
+    Off,
+    On,
+    Verify,     // every QueryCacheVerifyInterval-th hit is forwarded and its answer compared
+};
+
+// The upscale ratio, render resolution, jitter phase count and jitter offset queries only
+// depend on their inputs. Writes the outputs of desc and returns true when the same query
+// was answered before for this context, unchained queries only. Lock free, a slot being
+// written counts as a miss. The mode is read from the config once per ffxQuery.
+bool lookupQuery(ffxContext context, ffxQueryDescHeader* desc, QueryCacheMode mode);
+
+// Remembers the answer of a successful query the provider answered. In verify mode an
+// answer that differs from the cached one is counted and logged.
+void storeQuery(ffxContext context, const ffxQueryDescHeader* desc, QueryCacheMode mode);
+
+// Called when a context is destroyed, its handle may be reused by a context of another version
+void forgetQueries(ffxContext context);
+
+void reportQueryCache(FormatBuffer& out, std::string_view time);
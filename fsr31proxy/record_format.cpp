@@ -0,0 +1,474 @@
+#include "pch.h"
+#include "record_format.h"
+#include "descriptors.h"
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+const char* entryName(CaptureEntry entry)
+{
+    switch (entry)
+    {
+        case CaptureEntry::Message: return "message";
+        case CaptureEntry::CreateContext: return "ffxCreateContext";
+        case CaptureEntry::DestroyContext: return "ffxDestroyContext";
+        case CaptureEntry::Configure: return "ffxConfigure";
+        case CaptureEntry::Query: return "ffxQuery";
+        case CaptureEntry::Dispatch: return "ffxDispatch";
+        default: return "unknown";
+    }
+}
+
+// Walks the descriptors of a record, stops at anything that doesn't fit the payload
+template <typename F>
+static void forEachDescriptor(const CaptureRecord& record, F&& callback)
+{
+    size_t offset = 0;
+
+    for (uint32_t i = 0; i < record.header.descriptorCount; i++)
+    {
+        CaptureDescriptor descriptor;
+
+        if (offset + sizeof(descriptor) > record.header.size)
+            return;
+
+        memcpy(&descriptor, record.payload + offset, sizeof(descriptor));
+        offset += sizeof(descriptor);
+
+        if (offset + descriptor.size > record.header.size)
+            return;
+
+        callback(descriptor, record.payload + offset);
+        offset += capturePadding(descriptor.size);
+    }
+}
+
+static const char* nullText(const void* ptr)
+{
+    return ptr != nullptr ? "not null" : "null";
+}
+
+// "[time] text", the caller appends the value and the newline
+static FormatBuffer& beginLine(FormatBuffer& out, std::string_view time, std::string_view text)
+{
+    return out.append('[').append(time).append("] ").append(text);
+}
+
+// Text and JSON write the same fields, they only differ in how values are spelled. Text
+// keeps the classic "null"/"not null" for pointers, JSON writes their addresses.
+enum class FieldStyle
+{
+    Text,
+    Json,
+};
+
+template <typename T>
+static T readValue(const uint8_t* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// JSON has no NaN or infinity, they are written as null. The text log keeps nan and inf.
+template <typename T>
+static void appendScalar(FormatBuffer& out, T value, FieldStyle style)
+{
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        if (style == FieldStyle::Json && !std::isfinite(value))
+        {
+            out.append("null");
+            return;
+        }
+    }
+
+    out.appendNumber(value);
+}
+
+template <typename... T>
+static void appendTuple(FormatBuffer& out, FieldStyle style, T... values)
+{
+    const char* separator = style == FieldStyle::Text ? ", " : ",";
+    bool first = true;
+
+    out.append(style == FieldStyle::Text ? '{' : '[');
+    ((out.append(first ? "" : separator), appendScalar(out, values, style), first = false), ...);
+    out.append(style == FieldStyle::Text ? '}' : ']');
+}
+
+static void appendPointer(FormatBuffer& out, const void* value, FieldStyle style)
+{
+    if (style == FieldStyle::Text)
+        out.append(nullText(value));
+    else
+        out.appendNumber((uint64_t)(uintptr_t)value);
+}
+
+static void appendValue(FormatBuffer& out, FieldKind kind, const uint8_t* data, FieldStyle style)
+{
+    switch (kind)
+    {
+        case FieldKind::Bool:
+            out.appendBool(readValue<bool>(data));
+            break;
+
+        case FieldKind::Int32:
+            out.appendNumber(readValue<int32_t>(data));
+            break;
+
+        case FieldKind::UInt32:
+            out.appendNumber(readValue<uint32_t>(data));
+            break;
+
+        case FieldKind::UInt64:
+            out.appendNumber(readValue<uint64_t>(data));
+            break;
+
+        case FieldKind::Float:
+            appendScalar(out, readValue<float>(data), style);
+            break;
+
+        case FieldKind::Pointer:
+        case FieldKind::Callback:
+            appendPointer(out, readValue<void*>(data), style);
+            break;
+
+        case FieldKind::Resource:
+            appendPointer(out, readValue<FfxApiResource>(data).resource, style);
+            break;
+
+        case FieldKind::Dimensions2D:
+        {
+            auto value = readValue<FfxApiDimensions2D>(data);
+            appendTuple(out, style, value.width, value.height);
+            break;
+        }
+
+        case FieldKind::FloatCoords2D:
+        {
+            auto value = readValue<FfxApiFloatCoords2D>(data);
+            appendTuple(out, style, value.x, value.y);
+            break;
+        }
+
+        case FieldKind::Rect2D:
+        {
+            auto value = readValue<FfxApiRect2D>(data);
+            appendTuple(out, style, value.left, value.top, value.width, value.height);
+            break;
+        }
+    }
+}
+
+static void appendField(FormatBuffer& out, const FieldInfo& field, const uint8_t* data, FieldStyle style)
+{
+    auto size = fieldKindSize(field.kind);
+
+    if (field.count == 1)
+    {
+        appendValue(out, field.kind, data + field.offset, style);
+        return;
+    }
+
+    out.append(style == FieldStyle::Text ? '{' : '[');
+
+    for (uint32_t i = 0; i < field.count; i++)
+    {
+        if (i > 0)
+            out.append(style == FieldStyle::Text ? ", " : ",");
+
+        appendValue(out, field.kind, data + field.offset + i * size, style);
+    }
+
+    out.append(style == FieldStyle::Text ? '}' : ']');
+}
+
+// Pointers compare by what the style writes for them, everything else by value
+static bool fieldChanged(const FieldInfo& field, const uint8_t* data, const uint8_t* previous, FieldStyle style)
+{
+    if (previous == nullptr)
+        return true;
+
+    auto size = fieldKindSize(field.kind);
+
+    for (uint32_t i = 0; i < field.count; i++)
+    {
+        auto offset = field.offset + i * size;
+
+        if (field.kind == FieldKind::Pointer || field.kind == FieldKind::Callback || field.kind == FieldKind::Resource)
+        {
+            // FfxApiResource starts with its resource pointer
+            auto current = readValue<void*>(data + offset);
+            auto last = readValue<void*>(previous + offset);
+
+            if (style == FieldStyle::Text ? (current != nullptr) != (last != nullptr) : current != last)
+                return true;
+        }
+        else if (memcmp(data + offset, previous + offset, size) != 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Description of a captured descriptor, null if unknown or the size doesn't match this build
+static const DescriptorInfo* capturedInfo(const CaptureDescriptor& descriptor)
+{
+    auto info = findDescriptor(descriptor.type);
+    return info != nullptr && info->size == descriptor.size ? info : nullptr;
+}
+
+static const char* capturedProblem(const DescriptorInfo* info, const uint8_t* data)
+{
+    return info != nullptr && info->validate != nullptr ? info->validate(data) : nullptr;
+}
+
+const uint8_t* DescriptorDeltas::update(uint64_t context, uint64_t type, const uint8_t* current, uint32_t size)
+{
+    if (size > sizeof(Entry::last))
+        return nullptr;
+
+    Entry* entry = nullptr;
+    Entry* unused = nullptr;
+
+    for (auto& candidate : _entries)
+    {
+        if (candidate.used && candidate.context == context && candidate.type == type)
+        {
+            entry = &candidate;
+            break;
+        }
+
+        if (!candidate.used && unused == nullptr)
+            unused = &candidate;
+    }
+
+    // More live descriptors than slots, the extra ones are always written in full
+    if (entry == nullptr)
+    {
+        if (unused == nullptr)
+            return nullptr;
+
+        entry = unused;
+        entry->used = true;
+        entry->context = context;
+        entry->type = type;
+        entry->count = 0;
+    }
+
+    bool delta = keyframeInterval > 0 && entry->count % keyframeInterval != 0;
+
+    memcpy(_previous, entry->last, size);
+    memcpy(entry->last, current, size);
+    entry->count++;
+    return delta ? _previous : nullptr;
+}
+
+void DescriptorDeltas::remove(uint64_t context)
+{
+    for (auto& entry : _entries)
+    {
+        if (entry.used && entry.context == context)
+            entry.used = false;
+    }
+}
+
+static const uint8_t* deltaBase(DescriptorDeltas* deltas, const CaptureRecord& record, const CaptureDescriptor& descriptor, const uint8_t* data)
+{
+    return deltas != nullptr ? deltas->update(record.header.context, descriptor.type, data, descriptor.size) : nullptr;
+}
+
+static const char* chainProblem(const CaptureRecord& record)
+{
+    if (record.header.flags & CaptureFlagChainCycle)
+        return "cycle";
+
+    if (record.header.flags & CaptureFlagChainTruncated)
+        return "truncated";
+
+    return nullptr;
+}
+
+static void appendTypeName(FormatBuffer& out, uint64_t type, DescriptorNameFn nameFn)
+{
+    auto typeName = nameFn(type);
+
+    if (typeName != nullptr)
+        out.append(typeName);
+    else
+        out.appendNumber(type);
+}
+
+void formatRecordText(FormatBuffer& out, const CaptureRecord& record, std::string_view time, std::string_view endTime, bool fields, DescriptorNameFn nameFn, DescriptorDeltas* deltas)
+{
+    if (record.header.entry == CaptureEntry::Message)
+    {
+        beginLine(out, time, std::string_view((const char*)record.payload, record.header.size)).append('\n');
+        return;
+    }
+
+    std::string_view name = entryName(record.header.entry);
+    beginLine(out, time, name).append('\n');
+
+    forEachDescriptor(record, [&](const CaptureDescriptor& descriptor, const uint8_t* data)
+    {
+        beginLine(out, time, name).append(" desc->type: ");
+        appendTypeName(out, descriptor.type, nameFn);
+        out.append('\n');
+
+        auto info = capturedInfo(descriptor);
+
+        if (auto problem = capturedProblem(info, data))
+            beginLine(out, time, name).append(" desc invalid: ").append(problem).append('\n');
+
+        if (!fields || info == nullptr || info->fields.empty())
+            return;
+
+        auto previous = deltaBase(deltas, record, descriptor, data);
+
+        for (auto& field : info->fields)
+        {
+            if (!fieldChanged(field, data, previous, FieldStyle::Text))
+                continue;
+
+            beginLine(out, time, name).append(" desc->").append(field.name).append(": ");
+            appendField(out, field, data, FieldStyle::Text);
+            out.append('\n');
+        }
+    });
+
+    if (deltas != nullptr && record.header.entry == CaptureEntry::DestroyContext)
+        deltas->remove(record.header.context);
+
+    if (auto chain = chainProblem(record))
+        beginLine(out, time, name).append(" desc chain: ").append(chain).append('\n');
+
+    beginLine(out, endTime, name).append(" result: ").appendNumber(record.header.result);
+
+    if (record.header.flags & CaptureFlagCached)
+        out.append(" (cached)");
+
+    out.append('\n');
+}
+
+static void appendJsonString(FormatBuffer& out, const char* text, size_t length)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    out.append('"');
+
+    for (size_t i = 0; i < length; i++)
+    {
+        auto c = (unsigned char)text[i];
+
+        if (c == '"' || c == '\\')
+        {
+            out.append('\\').append((char)c);
+        }
+        else if (c < 0x20)
+        {
+            char escaped[6] = { '\\', 'u', '0', '0', digits[c >> 4], digits[c & 0xf] };
+            out.append(escaped, sizeof(escaped));
+        }
+        else
+        {
+            out.append((char)c);
+        }
+    }
+
+    out.append('"');
+}
+
+void formatRecordJson(FormatBuffer& out, const CaptureRecord& record, std::string_view time, DescriptorNameFn nameFn, DescriptorDeltas* deltas)
+{
+    out.append("{\"entry\":\"").append(entryName(record.header.entry));
+    out.append("\",\"time\":\"").append(time).append('"');
+    out.append(",\"sequence\":").appendNumber(record.header.sequence);
+    out.append(",\"thread\":").appendNumber(record.header.threadId);
+    out.append(",\"timestamp\":").appendNumber(record.header.timestamp);
+
+    if (record.header.entry == CaptureEntry::Message)
+    {
+        out.append(",\"text\":");
+        appendJsonString(out, (const char*)record.payload, record.header.size);
+        out.append('}');
+        return;
+    }
+
+    out.append(",\"endTimestamp\":").appendNumber(record.header.endTimestamp);
+    out.append(",\"context\":").appendNumber(record.header.context);
+    out.append(",\"result\":").appendNumber(record.header.result);
+
+    if (record.header.flags & CaptureFlagCached)
+        out.append(",\"cached\":true");
+
+    out.append(",\"descriptors\":[");
+
+    bool first = true;
+
+    forEachDescriptor(record, [&](const CaptureDescriptor& descriptor, const uint8_t* data)
+    {
+        if (!first)
+            out.append(',');
+
+        first = false;
+
+        auto typeName = nameFn(descriptor.type);
+        out.append("{\"type\":").appendNumber(descriptor.type);
+
+        if (typeName != nullptr)
+        {
+            out.append(",\"name\":");
+            appendJsonString(out, typeName, strlen(typeName));
+        }
+
+        out.append(",\"size\":").appendNumber(descriptor.size);
+
+        auto info = capturedInfo(descriptor);
+
+        if (auto problem = capturedProblem(info, data))
+        {
+            out.append(",\"invalid\":");
+            appendJsonString(out, problem, strlen(problem));
+        }
+
+        if (info == nullptr || info->fields.empty())
+        {
+            out.append(",\"data\":\"").appendHex(data, descriptor.size).append("\"}");
+            return;
+        }
+
+        auto previous = deltaBase(deltas, record, descriptor, data);
+
+        if (deltas != nullptr)
+            out.append(",\"keyframe\":").appendBool(previous == nullptr);
+
+        char separator = '{';
+        out.append(",\"fields\":");
+
+        for (auto& field : info->fields)
+        {
+            if (!fieldChanged(field, data, previous, FieldStyle::Json))
+                continue;
+
+            out.append(separator).append('"').append(field.name).append("\":");
+            appendField(out, field, data, FieldStyle::Json);
+            separator = ',';
+        }
+
+        out.append(separator == '{' ? "{}}" : "}}");
+    });
+
+    out.append(']');
+
+    if (auto chain = chainProblem(record))
+        out.append(",\"chain\":\"").append(chain).append('"');
+
+    out.append('}');
+
+    if (deltas != nullptr && record.header.entry == CaptureEntry::DestroyContext)
+        deltas->remove(record.header.context);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <string_view>
+#include "format_buffer.h"
+#include "trace_format.h"
+
+typedef const char* (*DescriptorNameFn)(uint64_t type);
+
+const char* entryName(CaptureEntry entry);
+
+// Last copy of every descriptor type per context, lets the formatters write only the fields
+// that changed with a full keyframe every keyframeInterval calls, 0 always writes everything.
+// Fixed size so it never allocates, owned by a single writer.
+class DescriptorDeltas
+{
+public:
+    uint32_t keyframeInterval = 0;
+
+    // Stores current, returns the previous copy when a delta should be written, null for a keyframe
+    const uint8_t* update(uint64_t context, uint64_t type, const uint8_t* current, uint32_t size);
+    void remove(uint64_t context);
+
+private:
+    static constexpr size_t EntryCount = 32;
+
+    struct Entry
+    {
+        uint64_t context = 0;
+        uint64_t type = 0;
+        uint32_t count = 0;
+        bool used = false;
+        uint8_t last[sizeof(CaptureRecord::payload)];
+    };
+
+    Entry _entries[EntryCount];
+    uint8_t _previous[sizeof(CaptureRecord::payload)];
+};
+
+// Text keeps the classic fsr31proxy.log layout, one line per field of every descriptor with
+// a field table. With fields == false only the call, its descriptor types and the result are
+// written. Records must be passed to deltas in capture order.
+void formatRecordText(FormatBuffer& out, const CaptureRecord& record, std::string_view time, std::string_view endTime, bool fields, DescriptorNameFn nameFn, DescriptorDeltas* deltas = nullptr);
+
+// One JSON object per record, without a trailing newline. Descriptors with a field table get
+// "fields", others their raw bytes as hex "data". With deltas descriptors are marked as
+// keyframe or not and only carry the changed fields.
+void formatRecordJson(FormatBuffer& out, const CaptureRecord& record, std::string_view time, DescriptorNameFn nameFn, DescriptorDeltas* deltas = nullptr);
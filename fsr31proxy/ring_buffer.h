@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free single-producer/single-consumer queue. Slots are preallocated
+// and filled in place, so pushing never allocates and never blocks.
+template <typename T, size_t Capacity>
+class RingBuffer
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "RingBuffer capacity must be a power of two");
+
+public:
+    RingBuffer() = default;
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    // Producer only. Calls fill(T&) on a free slot, returns false if the buffer is full
+    template <typename F>
+    bool tryPush(F&& fill)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+
+        if (head - _tail.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        fill(_cells[head & (Capacity - 1)]);
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Oldest slot or null if the buffer is empty, stays valid until pop()
+    const T* peek() const
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+
+        if (tail == _head.load(std::memory_order_acquire))
+            return nullptr;
+
+        return &_cells[tail & (Capacity - 1)];
+    }
+
+    void pop()
+    {
+        _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    alignas(64) std::atomic<size_t> _head{ 0 };
+    alignas(64) std::atomic<size_t> _tail{ 0 };
+    alignas(64) T _cells[Capacity];
+};
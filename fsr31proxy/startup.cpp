@@ -0,0 +1,77 @@
+#include "pch.h"
+#include "startup.h"
+#include "timer.h"
+#include <atomic>
+
+static std::atomic<uint64_t> _times[(size_t)StartupEvent::Count];
+
+bool markStartup(StartupEvent event, uint64_t timestamp)
+{
+    auto& time = _times[(size_t)event];
+    uint64_t expected = 0;
+
+    return time.load(std::memory_order_relaxed) == 0 && time.compare_exchange_strong(expected, timestamp, std::memory_order_relaxed);
+}
+
+uint64_t startupTime(StartupEvent event)
+{
+    return _times[(size_t)event].load(std::memory_order_relaxed);
+}
+
+static const char* eventName(StartupEvent event)
+{
+    switch (event)
+    {
+        case StartupEvent::Attach: return "attach";
+        case StartupEvent::FirstCall: return "first call";
+        case StartupEvent::ProviderLoaded: return "provider loaded";
+        case StartupEvent::FirstCreate: return "first ffxCreateContext";
+        case StartupEvent::FirstDispatch: return "first ffxDispatch";
+        default: return "unknown";
+    }
+}
+
+// Milliseconds with three decimals
+static void appendMillis(FormatBuffer& out, uint64_t ticks)
+{
+    auto micros = timerToNanoseconds(ticks) / 1000;
+    auto fraction = micros % 1000;
+
+    out.appendNumber(micros / 1000).append('.').appendNumber(fraction / 100).appendNumber(fraction / 10 % 10).appendNumber(fraction % 10).append(" ms");
+}
+
+void reportStartupTimeline(FormatBuffer& out, std::string_view time)
+{
+    auto attach = startupTime(StartupEvent::Attach);
+
+    if (attach == 0)
+        return;
+
+    out.append('[').append(time).append("] startup timeline:");
+
+    const char* separator = " ";
+
+    for (uint32_t i = 1; i < (uint32_t)StartupEvent::Count; i++)
+    {
+        auto timestamp = startupTime((StartupEvent)i);
+
+        if (timestamp < attach)
+            continue;
+
+        out.append(separator).append(eventName((StartupEvent)i)).append(" +");
+        appendMillis(out, timestamp - attach);
+        separator = ", ";
+    }
+
+    auto firstCall = startupTime(StartupEvent::FirstCall);
+    auto loaded = startupTime(StartupEvent::ProviderLoaded);
+
+    if (firstCall != 0 && loaded >= firstCall)
+    {
+        out.append(" (setup ");
+        appendMillis(out, loaded - firstCall);
+        out.append(')');
+    }
+
+    out.append('\n');
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include "format_buffer.h"
+
+// Points of the proxy's startup, each keeps the timestamp it was first reached at
+enum class StartupEvent : uint32_t
+{
+    Attach,             // the proxy was loaded into the process
+    FirstCall,          // first exported call, logging and the provider are set up in it
+    ProviderLoaded,
+    FirstCreate,
+    FirstDispatch,
+    Count
+};
+
+// Lock free, returns true for the first mark of an event, later ones are ignored. Cheap
+// enough for every call once the event was reached.
+bool markStartup(StartupEvent event, uint64_t timestamp);
+
+// 0 until the event was reached
+uint64_t startupTime(StartupEvent event);
+
+// Time of each event reached so far since Attach
+void reportStartupTimeline(FormatBuffer& out, std::string_view time);
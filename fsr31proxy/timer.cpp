@@ -0,0 +1,107 @@
+#include "pch.h"
+#include "timer.h"
+#include <chrono>
+#include <ctime>
+
+static uint64_t _frequency = 1;
+static uint64_t _startTicks = 0;
+static int64_t _startTime = 0;
+static int64_t _utcOffset = 0;
+
+void timerCalibrate()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    _frequency = (uint64_t)frequency.QuadPart;
+#else
+    _frequency = 1000000000ull;
+#endif
+
+    // Sample the wall clock between two tick reads and pin it to their midpoint
+    auto before = timerNow();
+    auto now = std::chrono::system_clock::now();
+    auto after = timerNow();
+
+    _startTicks = before + (after - before) / 2;
+    _startTime = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+
+    // Local time offset is taken once, a DST switch during the session isn't followed
+    auto seconds = (time_t)(_startTime / 1000000);
+    tm local = {};
+    tm utc = {};
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+    gmtime_s(&utc, &seconds);
+#else
+    localtime_r(&seconds, &local);
+    gmtime_r(&seconds, &utc);
+#endif
+    local.tm_isdst = 0;
+    utc.tm_isdst = 0;
+    _utcOffset = (int64_t)difftime(mktime(&local), mktime(&utc)) * 1000000;
+}
+
+uint64_t timerFrequency()
+{
+    return _frequency;
+}
+
+uint64_t timerStart()
+{
+    return _startTicks;
+}
+
+int64_t timerStartTime()
+{
+    return _startTime;
+}
+
+uint64_t timerToNanoseconds(uint64_t ticks)
+{
+    return (ticks / _frequency) * 1000000000ull + (ticks % _frequency) * 1000000000ull / _frequency;
+}
+
+double timerToMilliseconds(uint64_t ticks)
+{
+    return (double)ticks * 1000.0 / (double)_frequency;
+}
+
+static char* writeDigits(char* out, uint64_t value, int digits)
+{
+    for (int i = digits - 1; i >= 0; i--)
+    {
+        out[i] = (char)('0' + value % 10);
+        value /= 10;
+    }
+
+    return out + digits;
+}
+
+size_t timerFormat(uint64_t timestamp, char* buffer, size_t size)
+{
+    if (size < 16)
+        return 0;
+
+    auto elapsed = (int64_t)(timestamp - _startTicks);
+    auto elapsedMicros = elapsed >= 0 ? (int64_t)(timerToNanoseconds((uint64_t)elapsed) / 1000) : -(int64_t)(timerToNanoseconds((uint64_t)-elapsed) / 1000);
+
+    constexpr int64_t microsPerDay = 86400ll * 1000000ll;
+    auto timeOfDay = (_startTime + _utcOffset + elapsedMicros) % microsPerDay;
+    if (timeOfDay < 0)
+        timeOfDay += microsPerDay;
+
+    auto seconds = (uint64_t)(timeOfDay / 1000000);
+
+    char* out = buffer;
+    out = writeDigits(out, seconds / 3600, 2);
+    *out++ = ':';
+    out = writeDigits(out, (seconds / 60) % 60, 2);
+    *out++ = ':';
+    out = writeDigits(out, seconds % 60, 2);
+    *out++ = '.';
+    out = writeDigits(out, (uint64_t)(timeOfDay % 1000000), 6);
+    *out = 0;
+
+    return (size_t)(out - buffer);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// Raw monotonic ticks, cheap enough for the hot path. Conversion to wall clock
+// uses the calibration taken once by timerCalibrate().
+inline uint64_t timerNow()
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)counter.QuadPart;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void timerCalibrate();
+uint64_t timerFrequency();
+uint64_t timerStart();
+
+// Microseconds since unix epoch (UTC) at timerStart()
+int64_t timerStartTime();
+
+uint64_t timerToNanoseconds(uint64_t ticks);
+double timerToMilliseconds(uint64_t ticks);
+
+// Local time of day as "HH:MM:SS.uuuuuu", no localtime call per timestamp.
+// Returns the number of characters written, buffer needs at least 16 bytes.
+size_t timerFormat(uint64_t timestamp, char* buffer, size_t size);
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Capture records are stored in the ring buffer and in fsr31proxy.trace with the same layout,
+// so the writer can dump them verbatim and fsr31trace can read them back.
+
+constexpr char TraceMagic[8] = { 'F', 'F', 'X', 'T', 'R', 'A', 'C', 'E' };
+constexpr uint32_t TraceVersion = 2;
+
+enum class CaptureEntry : uint8_t
+{
+    Message,
+    CreateContext,
+    DestroyContext,
+    Configure,
+    Query,
+    Dispatch,
+    Count
+};
+
+constexpr size_t CaptureRecordSize = 1024;
+
+// Every descriptor copied into a record payload is prefixed with this header,
+// data follows padded to 8 bytes
+struct CaptureDescriptor
+{
+    uint64_t type;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+struct CaptureRecordHeader
+{
+    uint64_t sequence;      // global capture order across all threads
+    uint64_t timestamp;
+    uint64_t endTimestamp;
+    uint64_t context;
+    uint32_t threadId;
+    uint32_t result;
+    uint16_t size;          // used payload bytes
+    CaptureEntry entry;
+    uint8_t descriptorCount;
+    uint32_t flags;         // CaptureFlag bits
+};
+
+// The descriptor chain of a call wasn't captured in full
+constexpr uint32_t CaptureFlagChainCycle = 1;       // pNext looped back into the chain
+constexpr uint32_t CaptureFlagChainTruncated = 2;   // more descriptors than the record or the walk limit holds
+constexpr uint32_t CaptureFlagChainMask = CaptureFlagChainCycle | CaptureFlagChainTruncated;
+
+// The proxy answered the call from its query cache, the provider wasn't called
+constexpr uint32_t CaptureFlagCached = 4;
+
+struct CaptureRecord
+{
+    CaptureRecordHeader header;
+    alignas(8) uint8_t payload[CaptureRecordSize - sizeof(CaptureRecordHeader)];
+};
+
+static_assert(sizeof(CaptureRecord) == CaptureRecordSize);
+
+// File starts with TraceFileHeader, followed by entryCount + typeCount TraceNameEntry
+// items and then the records, each one a CaptureRecordHeader plus size payload bytes.
+struct TraceFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;            // offset of the first record
+    uint32_t recordHeaderSize;
+    uint32_t maxPayloadSize;
+    uint32_t pointerSize;
+    uint32_t entryCount;
+    uint32_t typeCount;
+    uint32_t reserved;
+    uint64_t timestampFrequency;    // timestamp ticks per second
+    uint64_t startTimestamp;
+    int64_t startTime;              // wall clock at startTimestamp, microseconds since unix epoch
+};
+
+struct TraceNameEntry
+{
+    uint64_t id;
+    uint32_t size;                  // descriptor size, 0 for entry points
+    uint32_t reserved;
+    char name[96];
+};
+
+inline size_t capturePadding(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
\ No newline at end of file
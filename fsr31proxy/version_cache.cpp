@@ -0,0 +1,381 @@
+#include "pch.h"
+#include "version_cache.h"
+#include "config.h"
+#include "log.h"
+#include "timer.h"
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// First line of the cache file, a file of another format version is rebuilt
+constexpr const char* VersionCacheMagic = "fsr31proxy versions 2";
+
+enum class VersionCacheState : uint32_t
+{
+    Off,
+    Unopened,       // no versions query yet
+    Loaded,         // the file matched the provider
+    Created,        // there was no file
+    Invalidated,    // the file was for another provider file or unreadable
+    Unusable,       // the provider file couldn't be read
+};
+
+// Provider file the cached lists belong to. Size and write time only, hashing the whole
+// file would hold up the first versions query on the game thread.
+struct ProviderIdentity
+{
+    uint64_t size = 0;
+    uint64_t time = 0;      // last write time in the file system's own units
+};
+
+// The names are handed out to the app, a list never changes or moves once added
+struct VersionList
+{
+    uint64_t createDescType = 0;
+    std::vector<uint64_t> ids;
+    std::vector<std::string> names;
+    std::vector<const char*> namePointers;
+};
+
+// Count only queries of lists that aren't complete yet
+struct ReportedCount
+{
+    uint64_t createDescType;
+    uint64_t count;
+};
+
+static std::mutex _lock;
+static std::string _filePath;
+static std::string _providerPath;
+static VersionCacheState _state = VersionCacheState::Off;
+static ProviderIdentity _identity;
+static std::vector<std::unique_ptr<VersionList>> _lists;
+static std::vector<std::unique_ptr<VersionList>> _retiredLists;
+static std::vector<ReportedCount> _reportedCounts;
+
+static std::atomic<uint64_t> _queries{ 0 };
+static std::atomic<uint64_t> _cachedQueries{ 0 };
+static std::atomic<uint64_t> _queryTicks{ 0 };
+
+// Capacity of the query lookupVersions let through, for the storeVersions after it
+static thread_local uint64_t _capacity = 0;
+static thread_local bool _pending = false;
+
+void openVersionCache(const char* providerPath)
+{
+    std::lock_guard lock(_lock);
+
+    // Next to the proxy like its config, the game's working directory is often somewhere else
+    if (_filePath.empty())
+    {
+        char path[1024];
+
+        if (modulePath((const void*)&openVersionCache, path, sizeof(path)))
+            _filePath = (std::filesystem::path(path).parent_path() / VersionCacheFileName).string();
+        else
+            _filePath = VersionCacheFileName;
+    }
+
+    for (auto& list : _lists)
+        _retiredLists.push_back(std::move(list));
+
+    _lists.clear();
+    _reportedCounts.clear();
+    _identity = {};
+    _providerPath = providerPath != nullptr ? providerPath : "";
+    _state = !_providerPath.empty() ? VersionCacheState::Unopened : VersionCacheState::Off;
+}
+
+static bool readIdentity(const std::string& path, ProviderIdentity& identity)
+{
+    std::error_code error;
+
+    identity.size = (uint64_t)std::filesystem::file_size(path, error);
+    if (error)
+        return false;
+
+    auto time = std::filesystem::last_write_time(path, error);
+    if (error)
+        return false;
+
+    identity.time = (uint64_t)time.time_since_epoch().count();
+    return true;
+}
+
+static VersionList* findList(uint64_t createDescType)
+{
+    for (auto& list : _lists)
+    {
+        if (list->createDescType == createDescType)
+            return list.get();
+    }
+
+    return nullptr;
+}
+
+static void addList(std::unique_ptr<VersionList> list)
+{
+    for (auto& name : list->names)
+        list->namePointers.push_back(name.c_str());
+
+    _lists.push_back(std::move(list));
+}
+
+// Lists of a truncated file are kept up to the first broken one
+static bool loadFile()
+{
+    std::ifstream input(_filePath);
+    if (!input.is_open())
+        return false;
+
+    std::string line;
+    unsigned long long size, time;
+
+    if (!std::getline(input, line) || line != VersionCacheMagic || !std::getline(input, line) ||
+        sscanf(line.c_str(), "provider %llu %llu", &size, &time) != 2 || size != _identity.size || time != _identity.time)
+    {
+        _state = VersionCacheState::Invalidated;
+        return true;
+    }
+
+    while (std::getline(input, line))
+    {
+        unsigned long long type, count;
+
+        if (sscanf(line.c_str(), "versions %llx %llu", &type, &count) != 2 || findList(type) != nullptr)
+            break;
+
+        auto list = std::make_unique<VersionList>();
+        list->createDescType = type;
+
+        for (uint64_t i = 0; i < count && std::getline(input, line); i++)
+        {
+            unsigned long long id;
+            int offset = 0;
+
+            if (sscanf(line.c_str(), "%llx %n", &id, &offset) != 1 || offset == 0)
+                break;
+
+            list->ids.push_back(id);
+            list->names.push_back(line.substr((size_t)offset));
+        }
+
+        if (list->ids.size() != count)
+            break;
+
+        addList(std::move(list));
+    }
+
+    _state = VersionCacheState::Loaded;
+    return true;
+}
+
+// Written next to the file and renamed over it, a second process never reads half a file
+static void saveFile()
+{
+    auto temporary = _filePath + ".tmp";
+
+    {
+        std::ofstream output(temporary, std::ios_base::out | std::ios_base::trunc);
+        if (!output.is_open())
+            return;
+
+        char line[96];
+        snprintf(line, sizeof(line), "provider %llu %llu", (unsigned long long)_identity.size, (unsigned long long)_identity.time);
+        output << VersionCacheMagic << '\n' << line << '\n';
+
+        for (auto& list : _lists)
+        {
+            snprintf(line, sizeof(line), "versions %llx %llu", (unsigned long long)list->createDescType, (unsigned long long)list->ids.size());
+            output << line << '\n';
+
+            for (size_t i = 0; i < list->ids.size(); i++)
+            {
+                snprintf(line, sizeof(line), "%llx ", (unsigned long long)list->ids[i]);
+                output << line << list->names[i] << '\n';
+            }
+        }
+
+        if (!output.flush())
+            return;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, _filePath, error);
+}
+
+// Identity and file are read on the first versions query, not when the proxy loads
+static void openFile()
+{
+    if (_state != VersionCacheState::Unopened)
+        return;
+
+    if (!readIdentity(_providerPath, _identity))
+    {
+        _state = VersionCacheState::Unusable;
+        log(LogLevel::Warning, LogCategoryGlobal, "versions cache: can't read " + _providerPath + ", versions queries are forwarded");
+        return;
+    }
+
+    if (!loadFile())
+        _state = VersionCacheState::Created;
+}
+
+bool lookupVersions(ffxQueryDescHeader* desc, bool enabled)
+{
+    _pending = false;
+
+    if (desc == nullptr || desc->type != FFX_API_QUERY_DESC_TYPE_GET_VERSIONS || desc->pNext != nullptr)
+        return false;
+
+    auto query = (ffxQueryDescGetVersions*)desc;
+
+    if (query->outputCount == nullptr || !enabled)
+        return false;
+
+    std::lock_guard lock(_lock);
+    openFile();
+
+    if (_state == VersionCacheState::Off || _state == VersionCacheState::Unusable)
+        return false;
+
+    auto list = findList(query->createDescType);
+
+    if (list == nullptr)
+    {
+        _capacity = *query->outputCount;
+        _pending = true;
+        return false;
+    }
+
+    auto available = (uint64_t)list->ids.size();
+    auto capacity = *query->outputCount;
+
+    if (capacity == 0)
+    {
+        *query->outputCount = available;
+        return true;
+    }
+
+    auto count = capacity < available ? capacity : available;
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        if (query->versionIds != nullptr)
+            query->versionIds[i] = list->ids[i];
+
+        if (query->versionNames != nullptr)
+            query->versionNames[i] = list->namePointers[i];
+    }
+
+    *query->outputCount = count;
+    return true;
+}
+
+static uint64_t reportedCount(uint64_t createDescType)
+{
+    for (auto& reported : _reportedCounts)
+    {
+        if (reported.createDescType == createDescType)
+            return reported.count;
+    }
+
+    return UINT64_MAX;
+}
+
+void storeVersions(const ffxQueryDescHeader* desc)
+{
+    if (!_pending || desc == nullptr || desc->type != FFX_API_QUERY_DESC_TYPE_GET_VERSIONS)
+        return;
+
+    _pending = false;
+
+    auto query = (const ffxQueryDescGetVersions*)desc;
+    auto count = *query->outputCount;
+
+    std::lock_guard lock(_lock);
+
+    if (_capacity == 0)
+    {
+        if (reportedCount(query->createDescType) == UINT64_MAX)
+            _reportedCounts.push_back({ query->createDescType, count });
+
+        return;
+    }
+
+    if (query->versionIds == nullptr || query->versionNames == nullptr || count > _capacity ||
+        (count == _capacity && count != reportedCount(query->createDescType)) || findList(query->createDescType) != nullptr)
+        return;
+
+    auto list = std::make_unique<VersionList>();
+    list->createDescType = query->createDescType;
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        std::string name = query->versionNames[i] != nullptr ? query->versionNames[i] : "";
+
+        // One version per line in the file
+        for (auto& c : name)
+        {
+            if (c == '\n' || c == '\r')
+                c = ' ';
+        }
+
+        list->ids.push_back(query->versionIds[i]);
+        list->names.push_back(std::move(name));
+    }
+
+    addList(std::move(list));
+    saveFile();
+}
+
+void countVersionQuery(const ffxQueryDescHeader* desc, uint64_t ticks, bool cached)
+{
+    if (desc == nullptr || desc->type != FFX_API_QUERY_DESC_TYPE_GET_VERSIONS)
+        return;
+
+    _queries.fetch_add(1, std::memory_order_relaxed);
+    _queryTicks.fetch_add(ticks, std::memory_order_relaxed);
+
+    if (cached)
+        _cachedQueries.fetch_add(1, std::memory_order_relaxed);
+}
+
+static const char* stateName(VersionCacheState state)
+{
+    switch (state)
+    {
+        case VersionCacheState::Off: return "versions cache off";
+        case VersionCacheState::Unopened: return "no versions queried";
+        case VersionCacheState::Loaded: return "provider unchanged";
+        case VersionCacheState::Created: return "versions cache created";
+        case VersionCacheState::Invalidated: return "provider changed, versions cache rebuilt";
+        case VersionCacheState::Unusable: return "provider file unreadable, versions cache unused";
+        default: return "unknown";
+    }
+}
+
+void reportStartup(uint64_t ticks)
+{
+    if (!logEnabled<LogLevel::Info>(LogCategoryGeneral))
+        return;
+
+    VersionCacheState state;
+    {
+        std::lock_guard lock(_lock);
+        state = proxyConfig().versionCache ? _state : VersionCacheState::Off;
+    }
+
+    char text[256];
+    auto length = snprintf(text, sizeof(text), "startup: first ffxCreateContext %.2f ms after the proxy loaded, %llu versions queries took %.3f ms, %llu of them cached (%s)",
+        timerToMilliseconds(ticks), (unsigned long long)_queries.load(std::memory_order_relaxed), timerToMilliseconds(_queryTicks.load(std::memory_order_relaxed)),
+        (unsigned long long)_cachedQueries.load(std::memory_order_relaxed), stateName(state));
+
+    if (length > 0)
+        log(LogLevel::Info, LogCategoryGeneral, text, sizeof(text));
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include "ffx_api.h"
+
+// Version lists the provider enumerated for ffxQueryDescGetVersions, kept across runs next
+// to the proxy and dropped as a whole when the provider file's size or write time changes
+constexpr const char* VersionCacheFileName = "fsr31proxy.versions";
+
+// Called whenever a provider is loaded, the size and write time of its file are only read on
+// the first versions query. Lists of a previous provider are dropped but kept in memory, apps may still
+// hold their names. An empty path forwards every versions query.
+void openVersionCache(const char* providerPath);
+
+// Answers an unchained versions query from a complete cached list, count only queries
+// included. Takes a lock, versions are queried a few times at startup. Forwards everything
+// while the cache is turned off in the config.
+bool lookupVersions(ffxQueryDescHeader* desc, bool enabled);
+
+// After a successful versions query that lookupVersions didn't answer on the same thread.
+// A list is kept once it is known to be complete: fewer versions than the capacity were
+// returned, or as many as an earlier count only query reported. New lists are saved at once.
+void storeVersions(const ffxQueryDescHeader* desc);
+
+// Time of a versions query, cached or forwarded, for the startup report. Other queries are ignored.
+void countVersionQuery(const ffxQueryDescHeader* desc, uint64_t ticks, bool cached);
+
+// Logs the time from loading the proxy to the first ffxCreateContext, with the versions
+// queries before it and whether they came from the cache file
+void reportStartup(uint64_t ticks);
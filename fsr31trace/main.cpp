@@ -0,0 +1,263 @@
+// fsr31trace: prints fsr31proxy.trace captures as text or JSON lines, or replays them
+#include "trace_format.h"
+#include "record_format.h"
+#include "descriptors.h"
+#include "replay.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static std::unordered_map<uint64_t, std::string> _traceTypeNames;
+static TraceFileHeader _header;
+static DescriptorDeltas _deltas;
+static bool _useDeltas = false;
+
+// Prefer the names stored in the trace, they match the proxy build that wrote it
+static const char* traceDescriptorName(uint64_t type)
+{
+    auto it = _traceTypeNames.find(type);
+    if (it != _traceTypeNames.end())
+        return it->second.c_str();
+
+    return descriptorName(type);
+}
+
+static std::string formatTime(uint64_t timestamp)
+{
+    auto ticks = (int64_t)(timestamp - _header.startTimestamp);
+    auto frequency = (int64_t)_header.timestampFrequency;
+    auto micros = _header.startTime + (ticks / frequency) * 1000000 + (ticks % frequency) * 1000000 / frequency;
+
+    time_t seconds = (time_t)(micros / 1000000);
+    tm local = {};
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d.%06d", local.tm_hour, local.tm_min, local.tm_sec, (int)(micros % 1000000));
+    return buffer;
+}
+
+static bool readHeader(std::istream& input)
+{
+    _traceTypeNames.clear();
+
+    if (!input.read((char*)&_header, sizeof(_header)) || memcmp(_header.magic, TraceMagic, sizeof(TraceMagic)) != 0)
+    {
+        std::cerr << "Not a fsr31proxy trace" << std::endl;
+        return false;
+    }
+
+    if (_header.version != TraceVersion)
+    {
+        std::cerr << "Unsupported trace version " << _header.version << ", expected " << TraceVersion << std::endl;
+        return false;
+    }
+
+    if (_header.recordHeaderSize < sizeof(CaptureRecordHeader) || _header.maxPayloadSize > sizeof(CaptureRecord::payload) || _header.timestampFrequency == 0)
+    {
+        std::cerr << "Trace record layout is not compatible with this decoder" << std::endl;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < _header.entryCount + _header.typeCount; i++)
+    {
+        TraceNameEntry entry;
+        if (!input.read((char*)&entry, sizeof(entry)))
+            return false;
+
+        entry.name[sizeof(entry.name) - 1] = 0;
+
+        if (i >= _header.entryCount)
+            _traceTypeNames[entry.id] = entry.name;
+    }
+
+    input.seekg(_header.headerSize, std::ios_base::beg);
+    return (bool)input;
+}
+
+static bool readRecord(std::istream& input, CaptureRecord& record)
+{
+    if (!input.read((char*)&record.header, sizeof(record.header)))
+        return false;
+
+    // Unused tail of a preallocated segment that wasn't truncated, e.g. after a crash
+    if (record.header.timestamp == 0)
+        return false;
+
+    if (_header.recordHeaderSize > sizeof(record.header))
+        input.ignore(_header.recordHeaderSize - sizeof(record.header));
+
+    if (record.header.size > sizeof(record.payload))
+    {
+        std::cerr << "Corrupt record, payload size " << record.header.size << std::endl;
+        return false;
+    }
+
+    return (bool)input.read((char*)record.payload, record.header.size);
+}
+
+// Calls handle for every record of the file, returns the number of records
+template <typename F>
+static uint64_t readFile(const char* fileName, F&& handle)
+{
+    std::ifstream input(fileName, std::ios_base::in | std::ios_base::binary);
+    if (!input.is_open())
+    {
+        std::cerr << "Failed to open trace file: " << fileName << std::endl;
+        return 0;
+    }
+
+    if (!readHeader(input))
+        return 0;
+
+    CaptureRecord record;
+    uint64_t count = 0;
+
+    while (readRecord(input, record))
+    {
+        if (!handle(record))
+            break;
+
+        count++;
+    }
+
+    return count;
+}
+
+static uint64_t decodeFile(const char* fileName, bool json)
+{
+    static FormatBuffer out;
+
+    return readFile(fileName, [&](const CaptureRecord& record)
+    {
+        out.clear();
+
+        if (json)
+        {
+            formatRecordJson(out, record, formatTime(record.header.timestamp), traceDescriptorName, _useDeltas ? &_deltas : nullptr);
+            out.append('\n');
+        }
+        else
+        {
+            formatRecordText(out, record, formatTime(record.header.timestamp), formatTime(record.header.endTimestamp), true, traceDescriptorName, _useDeltas ? &_deltas : nullptr);
+        }
+
+        std::cout << out.view();
+        return true;
+    });
+}
+
+static uint64_t replayFile(const char* fileName)
+{
+    bool checked = false;
+
+    return readFile(fileName, [&](const CaptureRecord& record)
+    {
+        if (!checked && !checkReplayTrace(_header))
+            return false;
+
+        checked = true;
+        replayRecord(record);
+        return true;
+    });
+}
+
+static int replay(int argc, char** argv)
+{
+    std::vector<const char*> fileNames;
+    auto timing = ReplayTiming::Fast;
+    double speed = 1.0;
+
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--pace") == 0)
+        {
+            timing = ReplayTiming::Paced;
+        }
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+        {
+            // Paced, with the captured time divided by the factor
+            timing = ReplayTiming::Paced;
+            speed = strtod(argv[++i], nullptr);
+        }
+        else
+        {
+            fileNames.push_back(argv[i]);
+        }
+    }
+
+    if (argc < 3 || fileNames.empty())
+    {
+        std::cerr << "Usage: fsr31trace replay <provider dll> <trace segment>... [--pace] [--speed <factor>]" << std::endl;
+        return 1;
+    }
+
+    if (!openReplayProvider(argv[2]))
+        return 1;
+
+    setReplayTiming(timing, speed);
+
+    uint64_t count = 0;
+
+    for (auto fileName : fileNames)
+        count += replayFile(fileName);
+
+    finishReplay();
+    return count > 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "replay") == 0)
+        return replay(argc, argv);
+
+    std::vector<const char*> fileNames;
+    bool json = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0)
+        {
+            json = true;
+        }
+        else if (strcmp(argv[i], "--delta") == 0 && i + 1 < argc)
+        {
+            // Only changed descriptor fields, full keyframe every N calls
+            _useDeltas = true;
+            _deltas.keyframeInterval = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            fileNames.push_back(argv[i]);
+        }
+    }
+
+    if (fileNames.empty())
+    {
+        std::cerr << "Usage: fsr31trace <trace segment>... [--json] [--delta <keyframe interval>]" << std::endl;
+        std::cerr << "       fsr31trace replay <provider dll> <trace segment>... [--pace] [--speed <factor>]" << std::endl;
+        return 1;
+    }
+
+    uint64_t count = 0;
+
+    // Segments of one session are decoded in the order given
+    for (auto fileName : fileNames)
+        count += decodeFile(fileName, json);
+
+    if (!json)
+        std::cerr << count << " records" << std::endl;
+
+    return count > 0 ? 0 : 1;
+}
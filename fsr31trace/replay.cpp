@@ -0,0 +1,418 @@
+// Re-issues the calls of a trace against a provider dll. Captured context handles are mapped to
+// the contexts the replay creates. Pointer fields are replaced by stable ids, numbered in the
+// order the trace first uses an address, and every id owns a block of zeroed scratch memory
+// that is passed instead, so providers can write query outputs and a mock can take handles
+// at face value. Callbacks point into the game and are cleared.
+//
+// Calls are issued back to back or paced by the captured timestamps, optionally sped up.
+// Either way a replay clock gives every call its time, and frameTimeDelta of replayed frame
+// dispatches is rewritten from it so providers see frame times that match the replay.
+#include "replay.h"
+#include "descriptors.h"
+#include "platform.h"
+#include "record_format.h"
+#include "ffx_api.h"
+#include "ffx_upscale.h"
+#include "ffx_framegeneration.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Largest output a query writes through one pointer is well below this
+constexpr size_t ReplayScratchSize = 1024;
+
+// Paced waits sleep until this close to a call and spin the rest, sleeping alone overshoots
+// by up to a scheduler tick
+constexpr std::chrono::microseconds ReplaySpinTime{ 2000 };
+
+// Paced calls issued later than this after their time count as late
+constexpr std::chrono::microseconds ReplayLateTime{ 1000 };
+
+using ReplayClock = std::chrono::steady_clock;
+
+struct ReplayEntryStats
+{
+    uint64_t calls = 0;
+    uint64_t mismatches = 0;        // result differs from the captured one
+    uint64_t skipped = 0;           // context was never created in the replay
+    uint64_t replayNanoseconds = 0;
+    uint64_t capturedTicks = 0;
+};
+
+struct ReplayContext
+{
+    ffxContext context = nullptr;
+    int64_t lastFrame = -1;         // replay clock of the previous frame dispatch, nanoseconds
+};
+
+// Where the frame time of a rebuilt chain's frame dispatch is, if it has one
+struct ReplayChain
+{
+    ffxApiHeader* first = nullptr;
+    float* frameTimeDelta = nullptr;
+    bool complete = true;
+};
+
+static LibraryHandle _provider = nullptr;
+static PfnFfxCreateContext _createContext = nullptr;
+static PfnFfxDestroyContext _destroyContext = nullptr;
+static PfnFfxConfigure _configure = nullptr;
+static PfnFfxQuery _query = nullptr;
+static PfnFfxDispatch _dispatch = nullptr;
+
+static ReplayTiming _timing = ReplayTiming::Fast;
+static double _speed = 1.0;
+static ReplayClock::time_point _start;
+static uint64_t _firstTimestamp = 0;
+static bool _started = false;
+static uint64_t _lateCalls = 0;
+static ReplayClock::duration _maxLateness{};
+
+static std::unordered_map<uint64_t, ReplayContext> _contexts;
+static std::unordered_map<uint64_t, uint32_t> _pointerIds;
+static std::vector<std::unique_ptr<uint8_t[]>> _scratch;      // indexed by id - 1
+static ReplayEntryStats _stats[(size_t)CaptureEntry::Count];
+static uint64_t _incompleteChains = 0;
+static uint64_t _timestampFrequency = 0;
+alignas(8) static uint8_t _chain[sizeof(CaptureRecord::payload)];
+
+bool openReplayProvider(const char* fileName)
+{
+    _provider = loadLibrary(fileName);
+
+    if (_provider == nullptr)
+    {
+        std::cerr << "Failed to load provider: " << fileName << std::endl;
+        return false;
+    }
+
+    _createContext = (PfnFfxCreateContext)librarySymbol(_provider, "ffxCreateContext");
+    _destroyContext = (PfnFfxDestroyContext)librarySymbol(_provider, "ffxDestroyContext");
+    _configure = (PfnFfxConfigure)librarySymbol(_provider, "ffxConfigure");
+    _query = (PfnFfxQuery)librarySymbol(_provider, "ffxQuery");
+    _dispatch = (PfnFfxDispatch)librarySymbol(_provider, "ffxDispatch");
+
+    if (_createContext == nullptr || _destroyContext == nullptr || _configure == nullptr || _query == nullptr || _dispatch == nullptr)
+    {
+        std::cerr << "Provider doesn't export the ffx-api entry points: " << fileName << std::endl;
+        freeLibrary(_provider);
+        _provider = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void setReplayTiming(ReplayTiming timing, double speed)
+{
+    _timing = timing;
+    _speed = speed > 0.0 ? speed : 1.0;
+}
+
+bool checkReplayTrace(const TraceFileHeader& header)
+{
+    if (header.pointerSize != sizeof(void*))
+    {
+        std::cerr << "Trace was captured by a " << header.pointerSize * 8 << "-bit process, replay needs a " << sizeof(void*) * 8 << "-bit build" << std::endl;
+        return false;
+    }
+
+    _timestampFrequency = header.timestampFrequency;
+    return true;
+}
+
+// Scratch block of the address' stable id, null stays null
+static void* stablePointer(void* address)
+{
+    if (address == nullptr)
+        return nullptr;
+
+    auto [it, inserted] = _pointerIds.try_emplace((uint64_t)(uintptr_t)address, (uint32_t)_scratch.size() + 1);
+
+    if (inserted)
+        _scratch.push_back(std::make_unique<uint8_t[]>(ReplayScratchSize));
+
+    return _scratch[it->second - 1].get();
+}
+
+static void replacePointers(uint8_t* data, const DescriptorInfo& info)
+{
+    for (auto& field : info.fields)
+    {
+        auto size = fieldKindSize(field.kind);
+
+        for (uint32_t i = 0; i < field.count; i++)
+        {
+            auto value = data + field.offset + i * size;
+            void* address;
+
+            switch (field.kind)
+            {
+                case FieldKind::Pointer:
+                case FieldKind::Resource:
+                    // FfxApiResource starts with its resource pointer
+                    memcpy(&address, value, sizeof(address));
+                    address = stablePointer(address);
+                    memcpy(value, &address, sizeof(address));
+                    break;
+
+                case FieldKind::Callback:
+                    memset(value, 0, sizeof(void*));
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+static float* frameTimeDelta(uint8_t* data, uint64_t type)
+{
+    switch (type)
+    {
+        case FFX_API_DISPATCH_DESC_TYPE_UPSCALE: return &((ffxDispatchDescUpscale*)data)->frameTimeDelta;
+        case FFX_API_DISPATCH_DESC_TYPE_FRAMEGENERATION_PREPARE: return &((ffxDispatchDescFrameGenerationPrepare*)data)->frameTimeDelta;
+        default: return nullptr;
+    }
+}
+
+// Links the captured descriptors back into a chain. Descriptors this build has no layout for,
+// or captured with another size than it knows, are left out: their pointers can't be replaced
+// and would reach the provider as the game's addresses.
+static ReplayChain rebuildChain(const CaptureRecord& record)
+{
+    memcpy(_chain, record.payload, record.header.size);
+
+    ReplayChain chain;
+    chain.complete = (record.header.flags & CaptureFlagChainMask) == 0;
+
+    ffxApiHeader* last = nullptr;
+    size_t offset = 0;
+
+    for (uint32_t i = 0; i < record.header.descriptorCount && offset + sizeof(CaptureDescriptor) <= record.header.size; i++)
+    {
+        CaptureDescriptor descriptor;
+        memcpy(&descriptor, _chain + offset, sizeof(descriptor));
+
+        auto data = _chain + offset + sizeof(descriptor);
+        offset += sizeof(descriptor) + capturePadding(descriptor.size);
+
+        if (offset > record.header.size)
+            break;
+
+        auto info = findDescriptor(descriptor.type);
+
+        if (info == nullptr || info->size != descriptor.size)
+        {
+            chain.complete = false;
+            continue;
+        }
+
+        replacePointers(data, *info);
+
+        if (chain.frameTimeDelta == nullptr)
+            chain.frameTimeDelta = frameTimeDelta(data, descriptor.type);
+
+        auto header = (ffxApiHeader*)data;
+        header->pNext = nullptr;
+
+        if (last != nullptr)
+            last->pNext = header;
+        else
+            chain.first = header;
+
+        last = header;
+    }
+
+    return chain;
+}
+
+static int64_t ticksToNanoseconds(uint64_t ticks)
+{
+    if (_timestampFrequency == 0)
+        return 0;
+
+    return (int64_t)(ticks / _timestampFrequency * 1000000000 + ticks % _timestampFrequency * 1000000000 / _timestampFrequency);
+}
+
+// Replay clock of the call in nanoseconds: the elapsed replay time when fast, the captured
+// time divided by the speed when paced, in which case it also waits for that time
+static int64_t scheduleCall(const CaptureRecord& record)
+{
+    if (!_started)
+    {
+        _started = true;
+        _start = ReplayClock::now();
+        _firstTimestamp = record.header.timestamp;
+    }
+
+    if (_timing == ReplayTiming::Fast)
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(ReplayClock::now() - _start).count();
+
+    auto time = (int64_t)((double)ticksToNanoseconds(record.header.timestamp - _firstTimestamp) / _speed);
+    auto target = _start + std::chrono::nanoseconds(time);
+    auto now = ReplayClock::now();
+
+    if (now > target)
+    {
+        if (now - target > ReplayLateTime)
+            _lateCalls++;
+
+        if (now - target > _maxLateness)
+            _maxLateness = now - target;
+
+        return time;
+    }
+
+    if (target - now > ReplaySpinTime)
+        std::this_thread::sleep_until(target - ReplaySpinTime);
+
+    while (ReplayClock::now() < target)
+        std::this_thread::yield();
+
+    return time;
+}
+
+// The first frame of a context keeps the captured frame time, scaled to the replay speed
+static void updateFrameTime(ReplayContext& context, float* frameTimeDelta, int64_t time)
+{
+    if (context.lastFrame >= 0)
+        *frameTimeDelta = (float)((double)(time - context.lastFrame) / 1000000.0);
+    else if (_timing == ReplayTiming::Paced)
+        *frameTimeDelta = (float)(*frameTimeDelta / _speed);
+
+    context.lastFrame = time;
+}
+
+void replayRecord(const CaptureRecord& record)
+{
+    auto entry = record.header.entry;
+
+    if (entry == CaptureEntry::Message || entry >= CaptureEntry::Count)
+        return;
+
+    auto& stats = _stats[(size_t)entry];
+    ReplayContext created;
+    auto replayContext = &created;
+
+    // Global queries are captured without a context
+    if (entry != CaptureEntry::CreateContext && record.header.context != 0)
+    {
+        auto it = _contexts.find(record.header.context);
+
+        if (it == _contexts.end())
+        {
+            stats.skipped++;
+            return;
+        }
+
+        replayContext = &it->second;
+    }
+
+    auto chain = rebuildChain(record);
+
+    if (!chain.complete)
+        _incompleteChains++;
+
+    // Nothing left to pass, the provider would get a null descriptor the game never sent
+    if (chain.first == nullptr && record.header.descriptorCount > 0 && entry != CaptureEntry::DestroyContext)
+    {
+        stats.skipped++;
+        return;
+    }
+
+    auto time = scheduleCall(record);
+
+    if (chain.frameTimeDelta != nullptr && entry == CaptureEntry::Dispatch)
+        updateFrameTime(*replayContext, chain.frameTimeDelta, time);
+
+    auto contextArgument = entry == CaptureEntry::CreateContext || record.header.context != 0 ? &replayContext->context : nullptr;
+    ffxReturnCode_t result = FFX_API_RETURN_ERROR;
+
+    auto start = ReplayClock::now();
+
+    switch (entry)
+    {
+        case CaptureEntry::CreateContext: result = _createContext(contextArgument, chain.first, nullptr); break;
+        case CaptureEntry::DestroyContext: result = _destroyContext(contextArgument, nullptr); break;
+        case CaptureEntry::Configure: result = _configure(contextArgument, chain.first); break;
+        case CaptureEntry::Query: result = _query(contextArgument, chain.first); break;
+        case CaptureEntry::Dispatch: result = _dispatch(contextArgument, chain.first); break;
+        default: break;
+    }
+
+    auto elapsed = ReplayClock::now() - start;
+
+    stats.calls++;
+    stats.replayNanoseconds += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    stats.capturedTicks += record.header.endTimestamp - record.header.timestamp;
+
+    if (result != record.header.result)
+        stats.mismatches++;
+
+    if (entry == CaptureEntry::CreateContext && result == FFX_API_RETURN_OK)
+    {
+        // A create that failed in the game has no handle the trace could refer to
+        if (record.header.result == FFX_API_RETURN_OK)
+            _contexts[record.header.context] = created;
+        else
+            _destroyContext(&created.context, nullptr);
+    }
+    else if (entry == CaptureEntry::DestroyContext)
+    {
+        _contexts.erase(record.header.context);
+    }
+}
+
+void finishReplay()
+{
+    auto elapsed = _started ? ReplayClock::now() - _start : ReplayClock::duration{};
+
+    for (auto& [captured, context] : _contexts)
+        _destroyContext(&context.context, nullptr);
+
+    uint64_t calls = 0;
+    uint64_t mismatches = 0;
+    uint64_t skipped = 0;
+
+    for (uint32_t i = 0; i < (uint32_t)CaptureEntry::Count; i++)
+    {
+        auto& stats = _stats[i];
+
+        calls += stats.calls;
+        mismatches += stats.mismatches;
+        skipped += stats.skipped;
+
+        if (stats.calls == 0 && stats.skipped == 0)
+            continue;
+
+        std::cout << entryName((CaptureEntry)i) << ": " << stats.calls << " calls, " << stats.mismatches << " result mismatches, " << stats.skipped << " skipped, ";
+        std::cout << stats.replayNanoseconds / 1000 << " us replayed, " << ticksToNanoseconds(stats.capturedTicks) / 1000 << " us captured" << std::endl;
+    }
+
+    std::cout << "replay: " << calls << " calls, " << mismatches << " result mismatches, " << skipped << " skipped, " << _contexts.size() << " contexts left alive, ";
+    std::cout << _incompleteChains << " incomplete chains, " << _scratch.size() << " pointer ids" << std::endl;
+
+    auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    std::cout << "replay time: " << milliseconds << " ms";
+
+    if (milliseconds > 0)
+        std::cout << ", " << calls * 1000 / milliseconds << " calls/s";
+
+    if (_timing == ReplayTiming::Paced)
+    {
+        std::cout << ", paced at " << _speed << "x, " << _lateCalls << " calls late, ";
+        std::cout << std::chrono::duration_cast<std::chrono::microseconds>(_maxLateness).count() << " us max late";
+    }
+
+    std::cout << std::endl;
+
+    _contexts.clear();
+    freeLibrary(_provider);
+    _provider = nullptr;
+}
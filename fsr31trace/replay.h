@@ -0,0 +1,23 @@
+#pragma once
+#include "trace_format.h"
+
+// Loads the provider dll the captured calls are re-issued against, it only needs the five
+// ffx-api entry points, so the original dll and fsr31mock both work
+bool openReplayProvider(const char* fileName);
+
+enum class ReplayTiming
+{
+    Fast,       // back to back, for peak call throughput
+    Paced,      // keeps the captured gaps between calls divided by the speed, 1 is the original pacing
+};
+
+void setReplayTiming(ReplayTiming timing, double speed);
+
+// Descriptors are replayed as captured, which needs the pointer size of the capturing process
+bool checkReplayTrace(const TraceFileHeader& header);
+
+// Records must be passed in capture order, messages are ignored
+void replayRecord(const CaptureRecord& record);
+
+// Destroys the contexts the trace left alive, prints the totals and unloads the provider
+void finishReplay();
@@ -0,0 +1,68 @@
+// Dispatches through the proxy's entry point against fsr31mock, with the proxy built with
+// FSR31PROXY_COUNT_ALLOCATIONS. Once warmed up a dispatch must not allocate on the calling
+// thread, from the context lookup to the captured record. The check is made here and not
+// through assert, which release builds compile out.
+#include "pch.h"
+#include "allocation_counter.h"
+#include "capture.h"
+#include "ffx_upscale.h"
+#include <cstdio>
+
+constexpr uint32_t WarmupDispatches = 256;
+constexpr uint32_t Dispatches = 100000;
+
+static bool check(bool condition, const char* what)
+{
+    if (!condition)
+        fprintf(stderr, "FAILED: %s\n", what);
+
+    return condition;
+}
+
+int main()
+{
+    ffxCreateContextDescUpscale create = {};
+    create.header.type = FFX_API_CREATE_CONTEXT_DESC_TYPE_UPSCALE;
+    create.maxRenderSize = { 1920, 1080 };
+    create.maxUpscaleSize = { 3840, 2160 };
+
+    ffxContext context = nullptr;
+
+    if (!check(ffxCreateContext(&context, &create.header, nullptr) == FFX_API_RETURN_OK, "context created"))
+        return 1;
+
+    ffxDispatchDescUpscale dispatch = {};
+    dispatch.header.type = FFX_API_DISPATCH_DESC_TYPE_UPSCALE;
+    dispatch.renderSize = { 1920, 1080 };
+    dispatch.upscaleSize = { 3840, 2160 };
+    dispatch.frameTimeDelta = 16.6f;
+
+    bool passed = true;
+
+    for (uint32_t i = 0; i < WarmupDispatches; i++)
+        passed &= check(ffxDispatch(&context, &dispatch.header) == FFX_API_RETURN_OK, "warmup dispatch");
+
+    auto captured = captureStats().captured;
+    auto scopes = allocatingScopes();
+    auto start = allocationCount();
+
+    for (uint32_t i = 0; i < Dispatches; i++)
+    {
+        // Reset now and then, the reset records take another path through the capture
+        dispatch.reset = i % 64 == 0;
+        passed &= ffxDispatch(&context, &dispatch.header) == FFX_API_RETURN_OK;
+    }
+
+    auto allocations = allocationCount() - start;
+
+    printf("%u dispatches, %llu captured, %llu allocations, %.4f per dispatch\n", Dispatches,
+        (unsigned long long)(captureStats().captured - captured), (unsigned long long)allocations, (double)allocations / Dispatches);
+
+    passed &= check(allocations == 0, "no allocations per dispatch");
+    passed &= check(allocatingScopes() == scopes, "no allocating scope");
+    passed &= check(captureStats().captured > captured, "dispatches captured");
+
+    passed &= check(ffxDestroyContext(&context, nullptr) == FFX_API_RETURN_OK, "context destroyed");
+
+    return passed ? 0 : 1;
+}
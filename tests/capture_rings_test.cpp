@@ -0,0 +1,101 @@
+// Many threads capture dispatches at once while the writer merges their rings. Every record
+// has to be either written or counted as dropped, and the time per record shouldn't grow
+// with the thread count, threads only ever touch their own ring. Records come in bursts
+// like frames do, so most of them fit into the rings and the merge has work to do.
+#include "pch.h"
+#include "capture.h"
+#include "file_sink.h"
+#include "timer.h"
+#include "ffx_upscale.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+constexpr uint32_t RecordsPerBurst = 128;
+constexpr uint32_t RecordsPerThread = 160 * RecordsPerBurst;
+constexpr uint32_t ThreadCounts[] = { 1, 2, 4, 8, 16 };
+
+static bool check(bool condition, const char* what)
+{
+    if (!condition)
+        fprintf(stderr, "FAILED: %s\n", what);
+
+    return condition;
+}
+
+int main()
+{
+    timerCalibrate();
+
+    FileSink trace;
+
+    if (!check(trace.open("capture_rings.trace", 16 * 1024 * 1024, 2), "trace file opened"))
+        return 1;
+
+    startCapture(nullptr, &trace);
+
+    // The writer logs a message of its own when it starts
+    check(flushCapture(), "writer started");
+
+    ffxDispatchDescUpscale dispatch = {};
+    dispatch.header.type = FFX_API_DISPATCH_DESC_TYPE_UPSCALE;
+    dispatch.renderSize = { 1920, 1080 };
+    dispatch.upscaleSize = { 3840, 2160 };
+    dispatch.frameTimeDelta = 16.6f;
+
+    bool passed = true;
+
+    for (auto threadCount : ThreadCounts)
+    {
+        auto before = captureStats();
+        std::atomic<uint64_t> ticks = 0;
+        std::vector<std::thread> threads;
+
+        for (uint32_t i = 0; i < threadCount; i++)
+        {
+            threads.emplace_back([&, i]()
+            {
+                auto context = (ffxContext)(uintptr_t)(0x10000 * (i + 1));
+
+                for (uint32_t record = 0; record < RecordsPerThread; record += RecordsPerBurst)
+                {
+                    auto start = timerNow();
+
+                    for (uint32_t burst = 0; burst < RecordsPerBurst; burst++)
+                    {
+                        auto now = timerNow();
+                        captureCall(CaptureEntry::Dispatch, context, &dispatch.header, now, now, FFX_API_RETURN_OK);
+                    }
+
+                    ticks.fetch_add(timerNow() - start, std::memory_order_relaxed);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+
+        passed &= check(flushCapture(), "writer flushed");
+
+        auto after = captureStats();
+        auto captured = after.captured - before.captured;
+        auto dropped = after.dropped - before.dropped;
+        auto written = after.written - before.written;
+        auto records = (uint64_t)threadCount * RecordsPerThread;
+
+        printf("%2u threads: %6.1f ns per record, %llu captured, %llu dropped, %llu out of order\n", threadCount,
+            (double)timerToNanoseconds(ticks.load()) / records, (unsigned long long)captured, (unsigned long long)dropped,
+            (unsigned long long)(after.outOfOrder - before.outOfOrder));
+
+        passed &= check(captured + dropped == records, "every record captured or counted as dropped");
+        passed &= check(written == captured, "every captured record written");
+    }
+
+    stopCapture();
+    trace.close();
+
+    return passed ? 0 : 1;
+}
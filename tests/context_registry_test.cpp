@@ -0,0 +1,144 @@
+// Creates and destroys thousands of contexts from many threads through the proxy's entry
+// points, against fsr31mock. The mock frees a context inside its destroy and allocates them
+// through the callbacks given to create, a shared free list hands a freed address straight to
+// a create on another thread while the proxy is still finishing the destroy. Every create has
+// to be tracked and untracked exactly once, and a live context has to be found with what it
+// was created with.
+#include "pch.h"
+#include "context_registry.h"
+#include "fsr31mock.h"
+#include "ffx_upscale.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+constexpr uint32_t ThreadCount = 16;
+constexpr uint32_t ContextsPerThread = 1024;
+constexpr uint32_t LiveContextsPerThread = 8;
+
+static std::atomic<uint32_t> _failures = 0;
+
+// Last freed, first reused. The mock allocates one size only.
+static std::mutex _freeLock;
+static std::vector<void*> _freeBlocks;
+
+static void* allocateShared(void*, uint64_t size)
+{
+    {
+        std::lock_guard lock(_freeLock);
+
+        if (!_freeBlocks.empty())
+        {
+            auto block = _freeBlocks.back();
+            _freeBlocks.pop_back();
+            return block;
+        }
+    }
+
+    return malloc(size);
+}
+
+static void freeShared(void*, void* block)
+{
+    if (block == nullptr)
+        return;
+
+    std::lock_guard lock(_freeLock);
+    _freeBlocks.push_back(block);
+}
+
+static void fail(const char* what)
+{
+    // Only the first few, a broken registry fails thousands of times
+    if (_failures.fetch_add(1) < 10)
+        fprintf(stderr, "FAILED: %s\n", what);
+}
+
+static void createAndDestroy(uint32_t thread)
+{
+    ffxCreateContextDescUpscale create = {};
+    create.header.type = FFX_API_CREATE_CONTEXT_DESC_TYPE_UPSCALE;
+    create.maxUpscaleSize = { 3840, 2160 };
+
+    ffxAllocationCallbacks allocator = { nullptr, allocateShared, freeShared };
+
+    ffxDispatchDescUpscale dispatch = {};
+    dispatch.header.type = FFX_API_DISPATCH_DESC_TYPE_UPSCALE;
+    dispatch.renderSize = { 1280, 720 };
+
+    ffxContext live[LiveContextsPerThread] = {};
+
+    for (uint32_t i = 0; i < ContextsPerThread + LiveContextsPerThread; i++)
+    {
+        auto& context = live[i % LiveContextsPerThread];
+
+        if (context != nullptr && ffxDestroyContext(&context, &allocator) != FFX_API_RETURN_OK)
+            fail("destroy");
+
+        context = nullptr;
+
+        if (i >= ContextsPerThread)
+            continue;
+
+        // Each context gets sizes of its own to be recognized by
+        create.maxRenderSize = { 1280 + thread, 720 + i };
+
+        if (ffxCreateContext(&context, &create.header, &allocator) != FFX_API_RETURN_OK)
+        {
+            fail("create");
+            context = nullptr;
+            continue;
+        }
+
+        if (ffxDispatch(&context, &dispatch.header) != FFX_API_RETURN_OK)
+            fail("dispatch");
+
+        auto info = findContext(context);
+
+        if (info == nullptr)
+            fail("live context not found");
+        else if (info->maxRenderSize.width != 1280 + thread || info->maxRenderSize.height != 720 + i || info->dispatches.load() != 1)
+            fail("live context found with another context's info");
+    }
+}
+
+int main()
+{
+    auto before = contextRegistryStats();
+    std::vector<std::thread> threads;
+
+    for (uint32_t i = 0; i < ThreadCount; i++)
+        threads.emplace_back(createAndDestroy, i);
+
+    for (auto& thread : threads)
+        thread.join();
+
+    auto after = contextRegistryStats();
+    auto contexts = (uint64_t)ThreadCount * ContextsPerThread;
+
+    printf("%llu contexts created, %llu destroyed, %llu live, %llu overflowed, %llu destroyed unknown\n",
+        (unsigned long long)(after.created - before.created), (unsigned long long)(after.destroyed - before.destroyed), (unsigned long long)after.live,
+        (unsigned long long)after.overflowed, (unsigned long long)after.unknownDestroys);
+
+    if (after.created - before.created != contexts || after.destroyed - before.destroyed != contexts)
+        fail("every context tracked and untracked once");
+
+    if (after.live != 0 || after.overflowed != 0 || after.unknownDestroys != 0)
+        fail("registry empty again");
+
+    // The proxy loaded the mock from FSR31PROXY_PROVIDER
+    auto mock = dlopen(getenv("FSR31PROXY_PROVIDER"), RTLD_NOW | RTLD_NOLOAD);
+    auto callCount = mock != nullptr ? (PfnFsr31mockCallCount)dlsym(mock, "fsr31mockCallCount") : nullptr;
+
+    if (callCount == nullptr || callCount(FSR31MOCK_CREATE_CONTEXT) != contexts || callCount(FSR31MOCK_DESTROY_CONTEXT) != contexts)
+        fail("every call forwarded to the mock");
+
+    for (auto block : _freeBlocks)
+        free(block);
+
+    return _failures.load() == 0 ? 0 : 1;
+}
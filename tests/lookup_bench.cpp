@@ -0,0 +1,173 @@
+// Lookups on the call path. Descriptor types are found through a table indexed by effect id
+// and the low type bits, so the first and the last known type should cost the same, a linear
+// scan over the same list is timed next to it for comparison. Contexts are found in an open
+// addressing table, timed for hits and misses while fresh and after thousands of contexts
+// came and went and left every slot used.
+#include "pch.h"
+#include "context_registry.h"
+#include "descriptors.h"
+#include "timer.h"
+#include <algorithm>
+#include <cstdio>
+#include <span>
+
+constexpr uint32_t Iterations = 2000000;
+constexpr size_t TypesPerRow = 8;
+
+// A game has a few contexts alive, a tool creating one per test many more
+constexpr uint32_t LiveContexts = 64;
+constexpr uint32_t ChurnedContexts = 8 * ContextRegistryCapacity;
+
+// Types to look up are cycled through from an array, a modulo per lookup would cost more
+// than the lookup itself
+constexpr uint32_t CycleLength = 1024;
+static uint64_t _cycle[CycleLength];
+
+// Keeps the compiler from dropping the lookups
+static volatile uintptr_t _sink;
+
+static void fillCycle(std::span<const uint64_t> types)
+{
+    for (uint32_t i = 0; i < CycleLength; i++)
+        _cycle[i] = types[i % types.size()];
+}
+
+// Once to warm up, then timed
+template <typename F>
+static double nanosecondsPer(F&& lookup)
+{
+    uintptr_t sum = 0;
+
+    for (uint32_t i = 0; i < CycleLength; i++)
+        sum += lookup(_cycle[i]);
+
+    auto start = timerNow();
+
+    for (uint32_t i = 0; i < Iterations; i++)
+        sum += lookup(_cycle[i & (CycleLength - 1)]);
+
+    auto ticks = timerNow() - start;
+    _sink = sum;
+    return (double)timerToNanoseconds(ticks) / Iterations;
+}
+
+static const DescriptorInfo* scanDescriptors(std::span<const DescriptorInfo> known, uint64_t type)
+{
+    for (auto& info : known)
+    {
+        if (info.type == type)
+            return &info;
+    }
+
+    return nullptr;
+}
+
+static bool benchDescriptors()
+{
+    auto known = knownDescriptors();
+    bool passed = true;
+
+    for (auto& info : known)
+    {
+        if (findDescriptor(info.type) != &info)
+        {
+            fprintf(stderr, "FAILED: %s not found by its type 0x%llx\n", info.name, (unsigned long long)info.type);
+            passed = false;
+        }
+    }
+
+    printf("descriptor lookup, %zu known types\n", known.size());
+
+    auto table = [](uint64_t type) { return (uintptr_t)findDescriptor(type); };
+    auto scan = [&](uint64_t type) { return (uintptr_t)scanDescriptors(known, type); };
+
+    for (size_t begin = 0; begin < known.size(); begin += TypesPerRow)
+    {
+        uint64_t types[TypesPerRow];
+        auto count = std::min(TypesPerRow, known.size() - begin);
+
+        for (size_t i = 0; i < count; i++)
+            types[i] = known[begin + i].type;
+
+        fillCycle(std::span(types, count));
+        printf("  types %2zu-%2zu: table %5.2f ns, linear scan %5.2f ns\n", begin + 1, begin + count, nanosecondsPer(table), nanosecondsPer(scan));
+    }
+
+    // Unknown types miss the table in the effect or the type bits, a scan has to see every entry
+    const uint64_t unknown[] = { 0x7fff0001u, 0x0001ffffu, 0x00010fffu, 0 };
+    fillCycle(unknown);
+
+    printf("  unknown:     table %5.2f ns, linear scan %5.2f ns\n", nanosecondsPer(table), nanosecondsPer(scan));
+    return passed;
+}
+
+// Handles look like heap pointers, never reused here so every lookup of another one misses
+static ffxContext fakeContext(uint32_t index)
+{
+    return (ffxContext)(uintptr_t)(0x10000000u + index * 0x230u);
+}
+
+static void timeContexts(const char* state)
+{
+    uint64_t live[LiveContexts];
+    uint64_t missing[LiveContexts];
+
+    for (uint32_t i = 0; i < LiveContexts; i++)
+    {
+        live[i] = (uint64_t)(uintptr_t)fakeContext(i);
+        missing[i] = (uint64_t)(uintptr_t)fakeContext(ChurnedContexts + LiveContexts + i);
+    }
+
+    auto find = [](uint64_t context) { return (uintptr_t)findContext((ffxContext)(uintptr_t)context); };
+
+    fillCycle(live);
+    auto hit = nanosecondsPer(find);
+    fillCycle(missing);
+    auto miss = nanosecondsPer(find);
+
+    printf("  %-28s hit %6.2f ns, miss %6.2f ns, probing up to %u slots\n", state, hit, miss, contextRegistryStats().probeLimit);
+}
+
+static bool benchContexts()
+{
+    bool passed = true;
+
+    printf("context lookup, %u live contexts, %u slots\n", LiveContexts, ContextRegistryCapacity);
+
+    for (uint32_t i = 0; i < LiveContexts; i++)
+        passed &= registerContext(fakeContext(i), nullptr, 0, nullptr) != nullptr;
+
+    timeContexts("fresh:");
+
+    // One at a time, like a tool creating a context per test
+    for (uint32_t i = LiveContexts; i < LiveContexts + ChurnedContexts; i++)
+    {
+        auto info = registerContext(fakeContext(i), nullptr, 0, nullptr);
+        retireContext(info);
+        unregisterContext(info, true);
+        passed &= info != nullptr;
+    }
+
+    timeContexts("after churn:");
+
+    for (uint32_t i = 0; i < LiveContexts; i++)
+        passed &= findContext(fakeContext(i)) != nullptr;
+
+    auto stats = contextRegistryStats();
+    passed &= stats.live == LiveContexts && stats.overflowed == 0 && stats.unknownDestroys == 0;
+
+    if (!passed)
+        fprintf(stderr, "FAILED: contexts lost in the registry\n");
+
+    return passed;
+}
+
+int main()
+{
+    timerCalibrate();
+
+    bool passed = benchDescriptors();
+    passed &= benchContexts();
+
+    return passed ? 0 : 1;
+}
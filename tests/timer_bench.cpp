@@ -0,0 +1,87 @@
+// Cost of a log timestamp per event. The proxy reads the raw counter on the calling thread
+// and formats it on the capture writer from a calibration taken once, the formatter it
+// replaced read the system clock and ran localtime, mktime and an ostringstream per line.
+// Both are timed, and the two have to agree on the time of day.
+#include "pch.h"
+#include "timer.h"
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+constexpr uint32_t Iterations = 200000;
+
+// Keeps the compiler from dropping the calls
+static volatile uint64_t _sink;
+
+// The formatter the log used before the timer, kept here for comparison
+static std::string formatWithLocaltime()
+{
+    auto now = std::chrono::system_clock::now();
+    auto now_t = std::chrono::system_clock::to_time_t(now);
+    auto now_tm = *std::localtime(&now_t);
+    auto now_duration = now - std::chrono::system_clock::from_time_t(std::mktime(&now_tm));
+    auto now_us = std::chrono::duration_cast<std::chrono::microseconds>(now_duration);
+    std::ostringstream oss;
+    oss << std::setfill('0') << std::setw(2) << now_tm.tm_hour << ":"
+        << std::setfill('0') << std::setw(2) << now_tm.tm_min << ":"
+        << std::setfill('0') << std::setw(2) << now_tm.tm_sec << "."
+        << std::setfill('0') << std::setw(6) << now_us.count();
+
+    return oss.str();
+}
+
+// Once to warm up, then timed
+template <typename F>
+static double nanosecondsPer(F&& event)
+{
+    uint64_t sum = 0;
+
+    for (uint32_t i = 0; i < 1000; i++)
+        sum += event(i);
+
+    auto start = timerNow();
+
+    for (uint32_t i = 0; i < Iterations; i++)
+        sum += event(i);
+
+    auto ticks = timerNow() - start;
+    _sink = sum;
+    return (double)timerToNanoseconds(ticks) / Iterations;
+}
+
+static int secondOfDay(const char* text)
+{
+    return ((text[0] - '0') * 10 + (text[1] - '0')) * 3600 + ((text[3] - '0') * 10 + (text[4] - '0')) * 60 + (text[6] - '0') * 10 + (text[7] - '0');
+}
+
+int main()
+{
+    timerCalibrate();
+
+    char buffer[32];
+    auto base = timerNow();
+
+    auto localtime = nanosecondsPer([](uint32_t) { return (uint64_t)formatWithLocaltime().size(); });
+    auto now = nanosecondsPer([](uint32_t) { return timerNow(); });
+    auto format = nanosecondsPer([&](uint32_t i) { return (uint64_t)timerFormat(base + i, buffer, sizeof(buffer)); });
+
+    printf("timestamp per event, %u events\n", Iterations);
+    printf("  %-32s %8.1f ns\n", "clock, localtime, ostringstream", localtime);
+    printf("  %-32s %8.1f ns on the calling thread\n", "timerNow", now);
+    printf("  %-32s %8.1f ns on the capture writer\n", "timerFormat", format);
+
+    auto old = formatWithLocaltime();
+    auto length = timerFormat(timerNow(), buffer, sizeof(buffer));
+
+    // A second apart at most, unless the two straddle midnight
+    auto difference = secondOfDay(buffer) - secondOfDay(old.c_str());
+    bool agree = length == old.size() && (difference == 0 || difference == 1 || difference == -86399);
+
+    if (!agree)
+        fprintf(stderr, "FAILED: timerFormat %s, localtime %s\n", buffer, old.c_str());
+
+    return agree ? 0 : 1;
+}